@@ -0,0 +1,492 @@
+// Microbenchmarks for the RateLimiter implementations.
+//
+// Usage: limiter_bench [duration_ms]
+
+#include "TokenBucket.h"
+#include "AtomicTokenBucket.h"
+#include "GcraLimiter.h"
+#include "PolicerTable.h"
+#include "ShardedTokenBucket.h"
+#include "BurstCreditLimiter.h"
+#include "RateSchedule.h"
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <cstdlib>
+#include <random>
+#include <algorithm>
+
+struct ContentionResult {
+    double opsPerSecond;
+    double nanosPerOp;
+};
+
+// Hammer one shared limiter from several threads for a fixed duration.
+// The rate is high enough that nearly every consume() succeeds, so the
+// numbers measure synchronization cost rather than rate limiting.
+ContentionResult runContention(RateLimiter& limiter, int threads,
+                               std::chrono::milliseconds duration) {
+    std::atomic<bool> go(false);
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> totalOps(0);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            while (!go) std::this_thread::yield();
+            uint64_t ops = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                limiter.consume(64);
+                ops++;
+            }
+            totalOps += ops;
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto& worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    ContentionResult result;
+    result.opsPerSecond = totalOps / seconds;
+    result.nanosPerOp = totalOps > 0 ? (seconds * 1e9 * threads) / totalOps : 0.0;
+    return result;
+}
+
+// Single-thread cost of consumeAt() on a virtual clock, i.e. the limiter's
+// own arithmetic and synchronization without the clock read
+void benchUncontended() {
+    const uint64_t rate = 1ULL << 40;
+    const uint64_t bucket = 1ULL << 31;
+    const uint64_t ops = 20000000;
+
+    std::vector<std::pair<std::string, std::shared_ptr<RateLimiter>>> limiters = {
+        {"TokenBucket (mutex)", std::make_shared<TokenBucket>(rate, bucket)},
+        {"AtomicTokenBucket (CAS)", std::make_shared<AtomicTokenBucket>(rate, bucket)},
+        {"GcraLimiter (CAS)", std::make_shared<GcraLimiter>(rate, bucket)},
+        {"ShardedTokenBucket (16)", std::make_shared<ShardedTokenBucket>(rate, bucket, 16)},
+    };
+
+    // glibc elides the atomics in mutexes while a process has only ever had
+    // one thread; a limiter in the simulator never runs in that mode
+    std::thread([] {}).join();
+
+    std::cout << "consumeAt(64) on a virtual clock, single thread\n";
+    std::cout << std::setw(26) << "Limiter" << std::setw(14) << "ns/op\n";
+    std::cout << std::string(40, '-') << "\n";
+    for (const auto& entry : limiters) {
+        uint64_t accepted = 0;
+        uint64_t now = 1000000000ULL;
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < ops; i++) {
+            now += 7;
+            accepted += entry.second->consumeAt(64, now);
+        }
+        double nanos = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cout << std::setw(26) << entry.first << std::setw(13) << std::fixed
+                  << std::setprecision(1) << nanos / ops << std::defaultfloat
+                  << (accepted == ops ? "" : "  (some rejected)") << "\n";
+    }
+    std::cout << "\n";
+}
+
+void benchContention(std::chrono::milliseconds duration) {
+    const uint64_t rate = 1ULL << 40;  // Effectively unlimited
+    const uint64_t bucket = 1ULL << 31;
+
+    std::vector<std::pair<std::string, std::function<std::shared_ptr<RateLimiter>()>>> limiters = {
+        {"TokenBucket (mutex)", [&] { return std::make_shared<TokenBucket>(rate, bucket); }},
+        {"AtomicTokenBucket (CAS)", [&] { return std::make_shared<AtomicTokenBucket>(rate, bucket); }},
+        {"GcraLimiter (CAS)", [&] { return std::make_shared<GcraLimiter>(rate, bucket); }},
+        {"ShardedTokenBucket (16)", [&] { return std::make_shared<ShardedTokenBucket>(rate, bucket, 16); }},
+    };
+
+    std::cout << "Shared limiter, consume(64) from N threads, "
+              << duration.count() << " ms per run\n";
+    std::cout << std::setw(26) << "Limiter" << std::setw(10) << "Threads"
+              << std::setw(14) << "Mops/s" << std::setw(14) << "ns/op\n";
+    std::cout << std::string(64, '-') << "\n";
+
+    for (const auto& entry : limiters) {
+        for (int threads : {1, 4, 16}) {
+            auto limiter = entry.second();
+            ContentionResult result = runContention(*limiter, threads, duration);
+            std::cout << std::setw(26) << entry.first << std::setw(10) << threads
+                      << std::setw(14) << std::fixed << std::setprecision(2)
+                      << result.opsPerSecond / 1e6
+                      << std::setw(13) << std::setprecision(1) << result.nanosPerOp << "\n";
+        }
+    }
+    std::cout << "\n";
+}
+
+// Drive a limiter in virtual time with an always-backlogged sender polling
+// seven times per packet time, and compare the achieved rate with the
+// configured one. Exercises the refill arithmetic without clock noise.
+double achievedRateError(RateLimiter& limiter, uint32_t packetSize, uint64_t packets) {
+    const long double rate = static_cast<long double>(limiter.getRate());
+    const long double packetNanos = packetSize * 1e9L / rate;
+    const long double step = std::max<long double>(packetNanos / 7, 1.0L);
+
+    // Drain the initial burst so only refilled tokens are measured
+    const uint64_t start = 1000000000ULL;
+    while (limiter.consumeAt(packetSize, start)) {}
+
+    uint64_t sent = 0;
+    long double now = start;
+    while (sent < packets) {
+        now += step;
+        while (limiter.consumeAt(packetSize, static_cast<uint64_t>(now))) {
+            sent++;
+        }
+    }
+    long double seconds = (now - start) / 1e9L;
+    long double achieved = sent * static_cast<long double>(packetSize) / seconds;
+    return static_cast<double>((achieved - rate) / rate);
+}
+
+void benchAccuracy() {
+    const uint64_t packets = 20000;
+    const uint32_t packetSize = 1500;
+    const uint64_t ratesBps[] = {1000ULL, 64000ULL, 10000000ULL, 1000000000ULL,
+                                 100000000000ULL, 400000000000ULL};
+
+    std::cout << "TokenBucket virtual-time rate accuracy, " << packets << " x " << packetSize
+              << " B packets\n";
+    std::cout << std::setw(16) << "Rate (bps)" << std::setw(16) << "Error %\n";
+    std::cout << std::string(32, '-') << "\n";
+
+    for (uint64_t bps : ratesBps) {
+        uint64_t rate = std::max<uint64_t>(bps / 8, 1);
+        TokenBucket bucket(rate, packetSize * 2);
+        std::cout << std::setw(16) << bps
+                  << std::setw(15) << std::scientific << std::setprecision(2)
+                  << achievedRateError(bucket, packetSize, packets) * 100
+                  << std::defaultfloat << "\n";
+    }
+    std::cout << "\n";
+}
+
+// Drain a full 100 KB bucket at 1 MB/s with a backlogged sender polling
+// every microsecond (virtual time), and report the largest number of bytes
+// released in any 1 ms window, with and without a tbf-style peak rate.
+void benchPeakRate() {
+    const uint64_t rate = 1000000;
+    const uint64_t bucket = 100000;
+    const uint32_t packetSize = 1500;
+    const uint64_t windowNs = 1000000;
+    const uint64_t durationNs = 200000000;
+
+    std::cout << "Burst drain of a full bucket, 1 MB/s, 100 KB, 1500 B packets\n";
+    std::cout << std::setw(22) << "Peak rate" << std::setw(22) << "Max bytes/ms"
+              << std::setw(22) << "Bucket empty after\n";
+    std::cout << std::string(65, '-') << "\n";
+
+    for (uint64_t peak : {0ULL, 10000000ULL, 2000000ULL}) {
+        TokenBucket limiter(rate, bucket);
+        limiter.setPeakRate(peak, 1514);
+
+        std::vector<uint64_t> windows(durationNs / windowNs, 0);
+        uint64_t start = 1000000000ULL;
+        uint64_t emptyAt = UINT64_MAX;
+        for (uint64_t t = 0; t < durationNs; t += 1000) {
+            while (limiter.consumeAt(packetSize, start + t)) {
+                windows[t / windowNs] += packetSize;
+            }
+            if (emptyAt == UINT64_MAX && limiter.getTokensAt(start + t) < packetSize) {
+                emptyAt = t;
+            }
+        }
+        uint64_t maxWindow = *std::max_element(windows.begin(), windows.end());
+        std::cout << std::setw(22) << (peak ? std::to_string(peak) + " B/s" : "none")
+                  << std::setw(22) << maxWindow
+                  << std::setw(19) << emptyAt / 1000000.0 << " ms\n";
+    }
+    std::cout << "\n";
+}
+
+// Feed GcraLimiter and TokenBucket the same random packet sequence in
+// virtual time, offered at about twice the rate. Both implement the same
+// contract, so they should accept the same bytes; decisions can only differ
+// on packets landing within rounding distance of a boundary, after which the
+// two run a packet apart until the bucket next fills.
+void benchGcraEquivalence() {
+    std::cout << "GcraLimiter vs TokenBucket, same offered packets\n";
+    std::cout << std::setw(14) << "Rate (B/s)" << std::setw(10) << "Bucket"
+              << std::setw(16) << "TokenBucket B" << std::setw(16) << "GcraLimiter B"
+              << std::setw(14) << "Diff %\n";
+    std::cout << std::string(69, '-') << "\n";
+
+    const uint64_t packets = 200000;
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<uint32_t> sizeDist(64, 1500);
+
+    for (uint64_t rate : {125ULL, 100000ULL, 125000000ULL, 50000000000ULL}) {
+        for (uint64_t bucket : {1500ULL, 64000ULL}) {
+            TokenBucket tokenBucket(rate, bucket);
+            GcraLimiter gcra(rate, bucket);
+            // Mean gap is half a mean packet's transmission time
+            std::exponential_distribution<double> gapDist(2.0 * rate / 782.0 / 1e9);
+
+            uint64_t bytesTokenBucket = 0, bytesGcra = 0;
+            double now = 1e9;
+            for (uint64_t i = 0; i < packets; i++) {
+                now += gapDist(rng);
+                uint32_t size = sizeDist(rng);
+                if (tokenBucket.consumeAt(size, static_cast<uint64_t>(now))) {
+                    bytesTokenBucket += size;
+                }
+                if (gcra.consumeAt(size, static_cast<uint64_t>(now))) {
+                    bytesGcra += size;
+                }
+            }
+            double diff = 100.0 * (static_cast<double>(bytesGcra) - bytesTokenBucket) /
+                          bytesTokenBucket;
+            std::cout << std::setw(14) << rate << std::setw(10) << bucket
+                      << std::setw(16) << bytesTokenBucket << std::setw(16) << bytesGcra
+                      << std::setw(13) << std::scientific << std::setprecision(2) << diff
+                      << std::defaultfloat << "\n";
+        }
+    }
+    std::cout << "\n";
+}
+
+// Cost of one batched refill pass over the per-flow policer table
+void benchPolicerRefill() {
+    std::cout << "PolicerTable batched refill\n";
+    std::cout << std::setw(12) << "Flows" << std::setw(16) << "us/pass"
+              << std::setw(16) << "ns/flow\n";
+    std::cout << std::string(44, '-') << "\n";
+
+    for (uint32_t flows : {1000u, 10000u, 100000u, 1000000u}) {
+        PolicerTable table;
+        for (uint32_t id = 0; id < flows; id++) {
+            table.setContract(id, 125000 + id, 15000);
+        }
+
+        const int passes = std::max<int>(20, 20000000 / static_cast<int>(flows));
+        uint64_t now = 1000000000ULL;
+        table.refillAt(now);
+        auto start = std::chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; pass++) {
+            now += 10000;  // 10 us ticks
+            table.refillAt(now);
+        }
+        double nanos = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count() / passes;
+
+        std::cout << std::setw(12) << flows
+                  << std::setw(16) << std::fixed << std::setprecision(1) << nanos / 1000
+                  << std::setw(15) << std::setprecision(2) << nanos / flows << "\n";
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+// Rate actually enforced when N threads share one limiter on the real
+// clock, all of them always backlogged. The initial burst is excluded.
+void benchSharedAccuracy(std::chrono::milliseconds duration) {
+    const uint64_t rate = 20000000;     // 20 MB/s
+    const uint64_t bucket = 64000;
+    const uint32_t packetSize = 1500;
+
+    std::vector<std::pair<std::string, std::function<std::shared_ptr<RateLimiter>()>>> limiters = {
+        {"TokenBucket (mutex)", [&] { return std::make_shared<TokenBucket>(rate, bucket); }},
+        {"ShardedTokenBucket (16)", [&] { return std::make_shared<ShardedTokenBucket>(rate, bucket, 16); }},
+    };
+
+    std::cout << "Shared limiter at " << rate / 1000000 << " MB/s, bucket " << bucket
+              << " B, backlogged consume(" << packetSize << ") from N threads\n";
+    std::cout << std::setw(26) << "Limiter" << std::setw(10) << "Threads"
+              << std::setw(14) << "Rate error" << "\n";
+    std::cout << std::string(50, '-') << "\n";
+
+    for (const auto& entry : limiters) {
+        for (int threads : {1, 4, 16}) {
+            auto limiter = entry.second();
+            std::atomic<bool> go(false);
+            std::atomic<bool> stop(false);
+            std::atomic<uint64_t> accepted(0);
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&] {
+                    while (!go) std::this_thread::yield();
+                    uint64_t bytes = 0;
+                    while (!stop.load(std::memory_order_relaxed)) {
+                        if (limiter->consume(packetSize)) {
+                            bytes += packetSize;
+                        } else {
+                            std::this_thread::yield();
+                        }
+                    }
+                    accepted += bytes;
+                });
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            go = true;
+            std::this_thread::sleep_for(duration);
+            stop = true;
+            for (auto& worker : workers) worker.join();
+            double seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+
+            double achieved = (static_cast<double>(accepted) - bucket) / seconds;
+            std::cout << std::setw(26) << entry.first << std::setw(10) << threads
+                      << std::setw(13) << std::fixed << std::setprecision(3)
+                      << (achieved - rate) * 100.0 / rate << "%\n";
+        }
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+// A week of a burstable link in virtual time: each day 20 hours of light
+// traffic well below baseline, which banks credit, then 4 hours of backlog
+// that spends it at the burst rate and falls back to baseline. The sender
+// jumps straight to the limiter's next eligible time, so the cost is per
+// segment sent, not per simulated tick.
+void benchBurstCredits() {
+    const uint64_t baseline = 1000000;          // 1 MB/s
+    const uint64_t burst = 10000000;            // 10 MB/s
+    const uint64_t maxCredits = 24000000000ULL; // 24 GB
+    const uint32_t segment = 64000;
+    const uint64_t second = 1000000000ULL;
+    const uint64_t lightGap = 320000000;        // One segment per 320 ms = 0.2 MB/s
+    const int days = 7;
+
+    BurstCreditLimiter limiter(baseline, burst, maxCredits, 0);
+    double burstSeconds = static_cast<double>(maxCredits) / (burst - baseline);
+    double expectedHeavy = maxCredits + baseline * 4.0 * 3600;
+
+    std::cout << "BurstCreditLimiter, " << baseline / 1000000 << " MB/s baseline, "
+              << burst / 1000000 << " MB/s burst, " << maxCredits / 1000000000ULL
+              << " GB credit, " << days << " virtual days (expect "
+              << std::fixed << std::setprecision(2) << expectedHeavy / 1e9
+              << " GB and " << std::setprecision(1) << burstSeconds / 60
+              << " min at burst per busy period)\n";
+    std::cout << std::setw(6) << "Day" << std::setw(16) << "Credit at busy"
+              << std::setw(14) << "Busy GB" << std::setw(16) << "Burst min" << "\n";
+    std::cout << std::string(52, '-') << "\n";
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t now = second;
+    uint64_t segments = 0;
+    for (int day = 1; day <= days; day++) {
+        uint64_t lightEnd = now + 20 * 3600 * second;
+        for (; now < lightEnd; now += lightGap) {
+            limiter.consumeAt(segment, now);
+            segments++;
+        }
+        uint64_t creditAtBusy = limiter.getCreditsAt(now);
+
+        uint64_t busyStart = now;
+        uint64_t busyEnd = now + 4 * 3600 * second;
+        uint64_t depleted = 0;
+        uint64_t busyBytes = 0;
+        while (now < busyEnd) {
+            if (limiter.consumeAt(segment, now)) {
+                busyBytes += segment;
+                segments++;
+            } else {
+                if (depleted == 0 && limiter.getCreditsAt(now) < segment) {
+                    depleted = now;
+                }
+                now += limiter.nanosUntilAvailableAt(segment, now);
+            }
+        }
+        std::cout << std::setw(6) << day
+                  << std::setw(13) << std::setprecision(2) << creditAtBusy / 1e9 << " GB"
+                  << std::setw(14) << busyBytes / 1e9
+                  << std::setw(16) << std::setprecision(1)
+                  << (depleted > 0 ? (depleted - busyStart) / 60e9 : 240.0) << "\n";
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << segments << " segments in " << std::setprecision(3) << wall
+              << " s wall time\n" << std::defaultfloat << "\n";
+}
+
+// TokenBucket following a random 1000-segment schedule (10 ms - 1 s
+// segments, 0 - 100 MB/s, outages included) in virtual time. A backlogged
+// sender either jumps to each next eligible time or polls every 50 ms, so a
+// single refill spans many segments. The bucket holds more than 50 ms at
+// the top rate, so nothing overflows: bytes sent plus bytes left in the
+// bucket, less the initial fill, should equal the integral of the rate.
+void benchRateSchedule() {
+    const uint64_t bucket = 8000000;
+    const uint32_t packetSize = 1500;
+    const uint64_t start = 1000000000ULL;
+
+    std::mt19937_64 rng(7);
+    auto schedule = std::make_shared<RateSchedule>();
+    std::vector<std::pair<uint64_t, uint64_t>> segments;   // start, rate
+    uint64_t end = 0;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t rate = rng() % 8 == 0 ? 0 : 100000 + rng() % 100000000;
+        schedule->addSegment(end, rate);
+        segments.push_back({end, std::max<uint64_t>(rate, 1)});
+        end += 10000000 + rng() % 990000000;
+    }
+    long double integral = 0;
+    for (size_t i = 0; i < segments.size(); i++) {
+        uint64_t until = i + 1 < segments.size() ? segments[i + 1].first : end;
+        integral += (until - segments[i].first) * static_cast<long double>(segments[i].second) / 1e9L;
+    }
+
+    std::cout << "TokenBucket on a " << schedule->size() << "-segment schedule, "
+              << end / 1000000000ULL << " s virtual\n";
+    std::cout << std::setw(20) << "Sender" << std::setw(14) << "Expected MB"
+              << std::setw(14) << "Error" << "\n";
+    std::cout << std::string(48, '-') << "\n";
+
+    for (bool polling : {false, true}) {
+        TokenBucket limiter(1, bucket);
+        limiter.setRateScheduleAt(schedule, start);
+        uint64_t now = start;
+        uint64_t sent = 0;
+        while (now < start + end) {
+            if (limiter.consumeAt(packetSize, now)) {
+                sent += packetSize;
+            } else if (polling) {
+                now += 50000000;
+            } else {
+                now += std::max<uint64_t>(limiter.nanosUntilAvailableAt(packetSize, now), 1);
+            }
+        }
+        now = start + end;
+        long double accounted = static_cast<long double>(sent) + limiter.getTokensAt(now) - bucket;
+        std::cout << std::setw(20) << (polling ? "polls every 50 ms" : "next eligible")
+                  << std::setw(14) << std::fixed << std::setprecision(1) << integral / 1e6
+                  << std::setw(13) << std::setprecision(4)
+                  << static_cast<double>((accounted - integral) * 100 / integral) << "%\n";
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::chrono::milliseconds duration(500);
+    if (argc > 1) {
+        duration = std::chrono::milliseconds(std::atoi(argv[1]));
+    }
+
+    std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << "\n\n";
+    benchAccuracy();
+    benchPeakRate();
+    benchGcraEquivalence();
+    benchPolicerRefill();
+    benchBurstCredits();
+    benchRateSchedule();
+    benchUncontended();
+    benchContention(duration);
+    benchSharedAccuracy(duration);
+    return 0;
+}
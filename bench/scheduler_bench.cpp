@@ -0,0 +1,844 @@
+// Microbenchmarks for the per-flow schedulers.
+//
+// Usage: scheduler_bench [operations]
+
+#include "DrrQueue.h"
+#include "Wf2qQueue.h"
+#include "SfqQueue.h"
+#include "TimingWheelQueue.h"
+#include "PifoRanks.h"
+#include "HfscQueue.h"
+#include "MultiQueueDiscipline.h"
+#include "TokenBucket.h"
+#include "ShardedTokenBucket.h"
+#include "PacketQueue.h"
+#include "TrafficShaper.h"
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+const uint32_t kFlowCounts[] = {1000, 10000, 100000};
+const uint64_t kLinkRate = 1250000000ULL;   // 10 Gbit/s in bytes/sec
+
+// Flow i has weight 1 + i % 4
+uint32_t weightOf(uint32_t flowId) {
+    return 1 + flowId % 4;
+}
+
+// Guaranteed rate of flow i when the weights split the whole link
+uint64_t rateOf(uint32_t flowId, uint32_t flows) {
+    uint64_t weights = 0;
+    for (uint32_t id = 0; id < flows; id++) {
+        weights += weightOf(id);
+    }
+    return kLinkRate * weightOf(flowId) / weights;
+}
+
+// Schedulers under test, with flow weights applied
+std::shared_ptr<QueueDiscipline> makeScheduler(const std::string& name, uint32_t flows,
+                                               size_t capacity) {
+    if (name == "DRR") {
+        auto drr = std::make_shared<DrrQueue>(capacity);
+        for (uint32_t id = 0; id < flows; id++) {
+            drr->setQuantum(id, DrrQueue::kMtu * weightOf(id));
+        }
+        return drr;
+    }
+    auto wf2q = std::make_shared<Wf2qQueue>(kLinkRate, capacity);
+    for (uint32_t id = 0; id < flows; id++) {
+        wf2q->setRate(id, rateOf(id, flows));
+    }
+    return wf2q;
+}
+
+// Every flow stays backlogged: each dequeued packet is put straight back at
+// the tail of its own flow, so all flows compete throughout. Reports the
+// cost of an enqueue/dequeue pair and the largest gap between a flow's bytes
+// and its weighted share, which both schedulers bound by about a quantum or
+// packet per flow however many flows there are.
+void benchBacklogged(uint64_t operations) {
+    std::cout << "All flows backlogged, weights 1-4, 64-1500 byte packets\n";
+    std::cout << std::setw(10) << "Scheduler" << std::setw(10) << "Flows"
+              << std::setw(14) << "ns/packet" << std::setw(22) << "Max share gap (B)" << "\n";
+    std::cout << std::string(56, '-') << "\n";
+
+    for (const std::string name : {"DRR", "WF2Q+"}) {
+        for (uint32_t flows : kFlowCounts) {
+            const uint32_t perFlow = 4;
+            auto queue = makeScheduler(name, flows, static_cast<size_t>(flows) * perFlow);
+            std::mt19937 rng(flows);
+            std::uniform_int_distribution<uint32_t> size(64, 1500);
+            for (uint32_t id = 0; id < flows; id++) {
+                for (uint32_t i = 0; i < perFlow; i++) {
+                    queue->enqueue(std::make_shared<Packet>(id, size(rng)));
+                }
+            }
+
+            // Warm up so every flow is mid-turn, then measure
+            std::vector<uint64_t> bytes(flows, 0);
+            for (uint64_t i = 0; i < flows * 4ULL; i++) {
+                queue->enqueue(queue->tryDequeue());
+            }
+            uint64_t ops = std::max<uint64_t>(operations, flows * 20ULL);
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < ops; i++) {
+                auto packet = queue->tryDequeue();
+                bytes[packet->getFlowId()] += packet->getSize();
+                queue->enqueue(std::move(packet));
+            }
+            double nanos = std::chrono::duration<double, std::nano>(
+                std::chrono::steady_clock::now() - start).count();
+
+            // Bytes per unit of weight should be the same for every flow
+            uint64_t total = 0;
+            uint64_t weights = 0;
+            for (uint32_t id = 0; id < flows; id++) {
+                total += bytes[id];
+                weights += weightOf(id);
+            }
+            double perWeight = static_cast<double>(total) / weights;
+            double worst = 0.0;
+            for (uint32_t id = 0; id < flows; id++) {
+                worst = std::max(worst, std::abs(bytes[id] - perWeight * weightOf(id)));
+            }
+            std::cout << std::setw(10) << name << std::setw(10) << flows
+                      << std::setw(14) << std::fixed << std::setprecision(1) << nanos / ops
+                      << std::setw(22) << std::setprecision(0) << worst << "\n";
+        }
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+// Worst per-flow queueing delay against the WF²Q+ latency bound, on a fully
+// loaded 10 Gbit/s link simulated in virtual time. Each flow is a greedy
+// (sigma, r) source: a burst of 1-4 packets of its own fixed size every
+// sigma / r, at a random phase, with r its guaranteed rate, so the rates
+// sum to the link rate. Flow i's bound is (sigma + L) / r + Lmax / link;
+// the table gives the worst ratio of measured delay to bound over all flows,
+// and how many flows exceeded it.
+void benchDelayBound() {
+    std::cout << "Worst-case delay vs WF2Q+ bound (sigma + L) / r + Lmax / C, "
+              << "10 Gbit/s link at full load\n";
+    std::cout << std::setw(10) << "Scheduler" << std::setw(10) << "Flows"
+              << std::setw(14) << "Packets" << std::setw(20) << "Worst delay/bound"
+              << std::setw(14) << "Over bound" << "\n";
+    std::cout << std::string(68, '-') << "\n";
+
+    const uint32_t maxPacket = 1500;
+    for (const std::string name : {"WF2Q+", "DRR"}) {
+        for (uint32_t flows : kFlowCounts) {
+            std::mt19937_64 rng(flows);
+            std::vector<uint32_t> packetSize(flows);
+            std::vector<uint32_t> burst(flows);
+            std::vector<double> period(flows);      // ns between bursts
+            std::vector<double> bound(flows);       // ns
+            double longestPeriod = 0.0;
+            for (uint32_t id = 0; id < flows; id++) {
+                packetSize[id] = 64 + rng() % (maxPacket - 63);
+                burst[id] = 1 + rng() % 4;
+                double rate = static_cast<double>(rateOf(id, flows));
+                double sigma = static_cast<double>(burst[id]) * packetSize[id];
+                period[id] = sigma / rate * 1e9;
+                bound[id] = (sigma + packetSize[id]) / rate * 1e9 + maxPacket * 1e9 / kLinkRate;
+                longestPeriod = std::max(longestPeriod, period[id]);
+            }
+
+            // Next burst time per flow, earliest first
+            using Arrival = std::pair<double, uint32_t>;
+            std::priority_queue<Arrival, std::vector<Arrival>, std::greater<Arrival>> arrivals;
+            std::uniform_real_distribution<double> phase(0.0, 1.0);
+            for (uint32_t id = 0; id < flows; id++) {
+                arrivals.emplace(phase(rng) * period[id], id);
+            }
+
+            auto queue = makeScheduler(name, flows, static_cast<size_t>(flows) * 16);
+            std::vector<std::deque<double>> arrivalTimes(flows);
+            std::vector<double> worst(flows, 0.0);
+            const double end = 2 * longestPeriod;
+            double now = 0.0;
+            uint64_t sent = 0;
+            while (now < end) {
+                // Admit every burst due by now; jump ahead if the link is idle
+                if (queue->empty() && arrivals.top().first > now) {
+                    now = arrivals.top().first;
+                }
+                while (arrivals.top().first <= now) {
+                    Arrival next = arrivals.top();
+                    arrivals.pop();
+                    for (uint32_t i = 0; i < burst[next.second]; i++) {
+                        queue->enqueue(std::make_shared<Packet>(next.second,
+                                                                packetSize[next.second]));
+                        arrivalTimes[next.second].push_back(next.first);
+                    }
+                    arrivals.emplace(next.first + period[next.second], next.second);
+                }
+
+                auto packet = queue->tryDequeue();
+                uint32_t id = packet->getFlowId();
+                now += packet->getSize() * 1e9 / kLinkRate;
+                worst[id] = std::max(worst[id], now - arrivalTimes[id].front());
+                arrivalTimes[id].pop_front();
+                sent++;
+            }
+
+            double worstRatio = 0.0;
+            uint32_t over = 0;
+            for (uint32_t id = 0; id < flows; id++) {
+                double ratio = worst[id] / bound[id];
+                worstRatio = std::max(worstRatio, ratio);
+                over += ratio > 1.0 ? 1 : 0;
+            }
+            std::cout << std::setw(10) << name << std::setw(10) << flows
+                      << std::setw(14) << sent << std::setw(20) << std::fixed
+                      << std::setprecision(3) << worstRatio << std::setw(14) << over << "\n";
+        }
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+// Jain's fairness index (sum x)^2 / (n * sum x^2) of SFQ throughput against
+// its bucket count. Every flow stays backlogged with equal 1000-byte packets,
+// so a flow alone in its bucket gets a full share and k colliding flows get
+// 1/k each. Without perturbation a collision lasts for the whole run; with
+// it the hash is re-seeded 20 times, so collisions move between flows and
+// the long-run shares even out.
+void benchSfqFairness() {
+    std::cout << "SFQ fairness (Jain index) vs bucket count, all flows backlogged\n";
+    std::cout << std::setw(10) << "Flows" << std::setw(10) << "Buckets"
+              << std::setw(18) << "Jain (static)" << std::setw(18) << "Jain (perturbed)" << "\n";
+    std::cout << std::string(56, '-') << "\n";
+
+    const uint32_t kPacketSize = 1000;
+    const uint32_t kPerturbations = 20;
+    for (uint32_t flows : {1000u, 10000u}) {
+        for (uint32_t buckets : {256u, 1024u, 4096u, 16384u, 65536u}) {
+            double jain[2];
+            for (int perturbed = 0; perturbed < 2; perturbed++) {
+                const uint32_t perFlow = 2;
+                size_t capacity = static_cast<size_t>(flows) * perFlow;
+                SfqQueue queue(capacity, buckets, static_cast<uint32_t>(capacity),
+                               std::chrono::milliseconds(0));
+                for (uint32_t id = 0; id < flows; id++) {
+                    for (uint32_t i = 0; i < perFlow; i++) {
+                        queue.enqueue(std::make_shared<Packet>(id, kPacketSize));
+                    }
+                }
+
+                std::vector<uint64_t> bytes(flows, 0);
+                uint64_t ops = flows * 100ULL;
+                for (uint64_t i = 0; i < ops; i++) {
+                    if (perturbed && i % (ops / kPerturbations) == 0) {
+                        queue.perturb();
+                    }
+                    auto packet = queue.tryDequeue();
+                    bytes[packet->getFlowId()] += packet->getSize();
+                    queue.enqueue(std::move(packet));
+                }
+
+                double sum = 0.0;
+                double sumSquares = 0.0;
+                for (uint64_t b : bytes) {
+                    sum += static_cast<double>(b);
+                    sumSquares += static_cast<double>(b) * b;
+                }
+                jain[perturbed] = sum * sum / (flows * sumSquares);
+            }
+            std::cout << std::setw(10) << flows << std::setw(10) << buckets
+                      << std::setw(18) << std::fixed << std::setprecision(4) << jain[0]
+                      << std::setw(18) << jain[1] << "\n";
+        }
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+// Per-flow pacing on a binary heap of departure times, the usual
+// alternative to a timing wheel (one O(log n) push and pop per packet)
+class HeapPacer {
+public:
+    explicit HeapPacer(uint32_t flows) : nextDeparture_(flows, 0.0), rate_(flows, 0.0) {}
+
+    void setRate(uint32_t flowId, uint64_t rate) { rate_[flowId] = static_cast<double>(rate); }
+
+    void enqueueAt(std::shared_ptr<Packet> packet, int64_t nowNs) {
+        uint32_t id = packet->getFlowId();
+        double departure = std::max(static_cast<double>(nowNs), nextDeparture_[id]);
+        nextDeparture_[id] = departure + packet->getSize() * 1e9 / rate_[id];
+        heap_.push(Entry{departure, sequence_++, std::move(packet)});
+    }
+
+    std::shared_ptr<Packet> tryDequeueAt(int64_t nowNs) {
+        if (heap_.empty() || heap_.top().departure > static_cast<double>(nowNs)) {
+            return nullptr;
+        }
+        auto packet = heap_.top().packet;
+        heap_.pop();
+        return packet;
+    }
+
+    int64_t nextEligibleTime() const {
+        return static_cast<int64_t>(std::ceil(heap_.top().departure));
+    }
+
+private:
+    struct Entry {
+        double departure;
+        uint64_t sequence;   // FIFO among equal departures
+        std::shared_ptr<Packet> packet;
+
+        bool operator>(const Entry& other) const {
+            return departure != other.departure ? departure > other.departure
+                                                : sequence > other.sequence;
+        }
+    };
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap_;
+    std::vector<double> nextDeparture_;
+    std::vector<double> rate_;
+    uint64_t sequence_ = 0;
+};
+
+// Cost and accuracy of per-flow pacing in virtual time. Every flow is paced
+// at its weighted share of a 10 Gbit/s link and kept backlogged: a packet is
+// put back on its own flow as soon as it departs. The clock jumps to the
+// pacer's next departure whenever nothing is due. The gap is the largest
+// difference between a flow's bytes and its rate times the run time, in
+// packets of that flow; an exact pacer stays within one.
+template <typename Pacer>
+void runPacer(const std::string& name, Pacer& pacer, uint32_t flows, uint64_t operations) {
+    const uint32_t perFlow = 4;
+    std::mt19937 rng(flows);
+    std::uniform_int_distribution<uint32_t> size(64, 1500);
+    std::vector<uint32_t> packetSize(flows);
+    for (uint32_t id = 0; id < flows; id++) {
+        pacer.setRate(id, rateOf(id, flows));
+        packetSize[id] = size(rng);
+        for (uint32_t i = 0; i < perFlow; i++) {
+            pacer.enqueueAt(std::make_shared<Packet>(id, packetSize[id]), 0);
+        }
+    }
+
+    std::vector<uint64_t> bytes(flows, 0);
+    int64_t now = 0;
+    uint64_t ops = std::max<uint64_t>(operations, flows * 20ULL);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ops; ) {
+        auto packet = pacer.tryDequeueAt(now);
+        if (!packet) {
+            now = std::max(now, pacer.nextEligibleTime());
+            continue;
+        }
+        bytes[packet->getFlowId()] += packet->getSize();
+        pacer.enqueueAt(std::move(packet), now);
+        i++;
+    }
+    double nanos = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+
+    double worst = 0.0;
+    for (uint32_t id = 0; id < flows; id++) {
+        double expected = rateOf(id, flows) * (now / 1e9);
+        worst = std::max(worst, std::abs(bytes[id] - expected) / packetSize[id]);
+    }
+    std::cout << std::setw(14) << name << std::setw(10) << flows
+              << std::setw(14) << std::fixed << std::setprecision(1) << nanos / ops
+              << std::setw(18) << std::setprecision(3) << worst << "\n";
+}
+
+void benchPacing(uint64_t operations) {
+    std::cout << "Per-flow pacing, flows backlogged at weighted shares of 10 Gbit/s\n";
+    std::cout << std::setw(14) << "Pacer" << std::setw(10) << "Flows"
+              << std::setw(14) << "ns/packet" << std::setw(18) << "Max gap (pkts)" << "\n";
+    std::cout << std::string(56, '-') << "\n";
+
+    for (uint32_t flows : kFlowCounts) {
+        HeapPacer heap(flows);
+        runPacer("Heap", heap, flows, operations);
+        // 10 us slots over a 2.6 s horizon
+        TimingWheelQueue wheel(static_cast<size_t>(flows) * 4, std::chrono::microseconds(10),
+                               1 << 18);
+        runPacer("Timing wheel", wheel, flows, operations);
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+// PIFO on a binary heap, the reference a bucketed PIFO approximates
+class HeapPifo {
+public:
+    explicit HeapPifo(PifoRankFunction rank) : rank_(std::move(rank)) {}
+
+    void enqueueAt(std::shared_ptr<Packet> packet, int64_t nowNs) {
+        uint64_t rank = rank_(*packet, PifoContext{nowNs, virtualTime_});
+        heap_.push(Entry{rank, sequence_++, std::move(packet)});
+    }
+
+    std::shared_ptr<Packet> tryDequeueAt(int64_t) {
+        if (heap_.empty()) {
+            return nullptr;
+        }
+        virtualTime_ = heap_.top().rank;
+        auto packet = heap_.top().packet;
+        heap_.pop();
+        return packet;
+    }
+
+    size_t getClampedRanks() const { return 0; }
+
+private:
+    struct Entry {
+        uint64_t rank;
+        uint64_t sequence;   // FIFO among equal ranks
+        std::shared_ptr<Packet> packet;
+
+        bool operator>(const Entry& other) const {
+            return rank != other.rank ? rank > other.rank : sequence > other.sequence;
+        }
+    };
+
+    PifoRankFunction rank_;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap_;
+    uint64_t virtualTime_ = 0;
+    uint64_t sequence_ = 0;
+};
+
+// Rank functions under test, with the bucket width (log2 ranks) that makes
+// the 64k-bucket window cover what is queued at once
+struct PifoPolicy {
+    std::string name;
+    unsigned rankShift;
+    std::function<PifoRankFunction(uint32_t flows)> make;
+};
+
+std::vector<PifoPolicy> pifoPolicies() {
+    auto budgets = [](uint32_t flows) {
+        std::unordered_map<uint32_t, std::chrono::microseconds> budgets;
+        for (uint32_t id = 0; id < flows; id++) {
+            budgets[id] = std::chrono::milliseconds(weightOf(id));
+        }
+        return budgets;
+    };
+    return {
+        {"FIFO", 13, [](uint32_t) { return PifoRanks::fifo(); }},
+        {"Fair queueing", 0, [](uint32_t flows) {
+             std::unordered_map<uint32_t, uint32_t> weights;
+             for (uint32_t id = 0; id < flows; id++) {
+                 weights[id] = weightOf(id) * PifoRanks::kShare;
+             }
+             return PifoRanks::fairQueueing(std::move(weights));
+         }},
+        {"EDF", 13, [budgets](uint32_t flows) { return PifoRanks::edf(budgets(flows)); }},
+        {"SRPT (LAS)", 4, [](uint32_t) { return PifoRanks::srpt(); }},
+        {"LSTF", 13, [budgets](uint32_t flows) {
+             return PifoRanks::lstf(budgets(flows), kLinkRate);
+         }},
+    };
+}
+
+// Backlogged flows on a 10 Gbit/s link in virtual time; every dequeued
+// packet goes straight back in, so each dequeue is matched by an enqueue
+// that runs the rank function. Returns ns per dequeue/enqueue pair.
+template <typename Pifo>
+double runPifo(Pifo& pifo, uint32_t flows, uint64_t operations) {
+    const uint32_t perFlow = 4;
+    std::mt19937 rng(flows);
+    std::uniform_int_distribution<uint32_t> size(64, 1500);
+    int64_t now = 0;
+    for (uint32_t id = 0; id < flows; id++) {
+        for (uint32_t i = 0; i < perFlow; i++) {
+            pifo.enqueueAt(std::make_shared<Packet>(id, size(rng)), now);
+        }
+    }
+
+    uint64_t ops = std::max<uint64_t>(operations, flows * 20ULL);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        auto packet = pifo.tryDequeueAt(now);
+        now += packet->getSize() * 1000000000LL / static_cast<int64_t>(kLinkRate);
+        pifo.enqueueAt(std::move(packet), now);
+    }
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / ops;
+}
+
+void benchPifo(uint64_t operations) {
+    std::cout << "PIFO rank functions, backlogged flows on a 10 Gbit/s link\n";
+    std::cout << std::setw(16) << "Rank" << std::setw(10) << "Flows"
+              << std::setw(16) << "Heap ns/pkt" << std::setw(16) << "PIFO ns/pkt"
+              << std::setw(12) << "PIFO Mpps" << std::setw(12) << "Clamped" << "\n";
+    std::cout << std::string(82, '-') << "\n";
+
+    for (const PifoPolicy& policy : pifoPolicies()) {
+        for (uint32_t flows : kFlowCounts) {
+            size_t capacity = static_cast<size_t>(flows) * 4;
+            HeapPifo heap(policy.make(flows));
+            double heapNanos = runPifo(heap, flows, operations);
+            PifoQueue pifo(policy.make(flows), capacity, 65536, policy.rankShift);
+            double pifoNanos = runPifo(pifo, flows, operations);
+            std::cout << std::setw(16) << policy.name << std::setw(10) << flows
+                      << std::setw(16) << std::fixed << std::setprecision(1) << heapNanos
+                      << std::setw(16) << pifoNanos
+                      << std::setw(12) << std::setprecision(2) << 1000.0 / pifoNanos
+                      << std::setw(12) << pifo.getClampedRanks() << "\n";
+        }
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+// HFSC tree of 'leaves' classes under about sqrt(leaves) tenants on a
+// 10 Gbit/s link. Every leaf has a link-sharing share by weight; every
+// other leaf also has a real-time curve at half that share, with a 1500
+// byte burst due within 10 ms.
+std::shared_ptr<HfscQueue> makeHfscTree(uint32_t leaves, size_t capacity) {
+    using Curve = HfscQueue::ServiceCurve;
+    auto hfsc = std::make_shared<HfscQueue>(capacity);
+    uint32_t numTenants = std::max<uint32_t>(
+        static_cast<uint32_t>(std::sqrt(static_cast<double>(leaves))), 1);
+    std::vector<uint64_t> tenantRate(numTenants, 0);
+    for (uint32_t id = 0; id < leaves; id++) {
+        tenantRate[id % numTenants] += rateOf(id, leaves);
+    }
+    std::vector<uint32_t> tenants(numTenants);
+    for (uint32_t t = 0; t < numTenants; t++) {
+        tenants[t] = hfsc->addClass(HfscQueue::kRoot, Curve(), Curve::linear(tenantRate[t]));
+    }
+    for (uint32_t id = 0; id < leaves; id++) {
+        uint64_t rate = rateOf(id, leaves);
+        Curve rt = id % 2 == 0 ? Curve::fromDelay(1500, std::chrono::milliseconds(10), rate / 2)
+                               : Curve();
+        uint32_t leaf = hfsc->addClass(tenants[id % numTenants], rt, Curve::linear(rate));
+        hfsc->assignFlow(id, leaf);
+    }
+    return hfsc;
+}
+
+// Cost of an HFSC dequeue/enqueue pair with every leaf backlogged, in
+// virtual time on a 10 Gbit/s link
+void benchHfscCost(uint64_t operations) {
+    std::cout << "HFSC, all leaves backlogged, half with real-time curves\n";
+    std::cout << std::setw(10) << "Leaves" << std::setw(10) << "Tenants"
+              << std::setw(14) << "ns/packet" << std::setw(18) << "Real-time share" << "\n";
+    std::cout << std::string(52, '-') << "\n";
+
+    for (uint32_t leaves : kFlowCounts) {
+        const uint32_t perFlow = 4;
+        auto hfsc = makeHfscTree(leaves, static_cast<size_t>(leaves) * perFlow);
+        std::mt19937 rng(leaves);
+        std::uniform_int_distribution<uint32_t> size(64, 1500);
+        int64_t now = 0;
+        for (uint32_t id = 0; id < leaves; id++) {
+            for (uint32_t i = 0; i < perFlow; i++) {
+                hfsc->enqueueAt(std::make_shared<Packet>(id, size(rng)), now);
+            }
+        }
+
+        uint64_t ops = std::max<uint64_t>(operations, leaves * 20ULL);
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < ops; i++) {
+            auto packet = hfsc->tryDequeueAt(now);
+            now += packet->getSize() * 1000000000LL / static_cast<int64_t>(kLinkRate);
+            hfsc->enqueueAt(std::move(packet), now);
+        }
+        double nanos = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+
+        // Tenants are classes 1..tenants; real-time bytes are all in leaves
+        uint32_t tenants = static_cast<uint32_t>(std::sqrt(static_cast<double>(leaves)));
+        uint64_t bytes = 0;
+        uint64_t realTime = 0;
+        for (uint32_t id = 1; id < hfsc->getNumClasses(); id++) {
+            auto stats = hfsc->getClassStats(id);
+            if (id <= tenants) {
+                bytes += stats.bytesSent;
+            }
+            realTime += stats.realTimeBytes;
+        }
+        std::cout << std::setw(10) << leaves << std::setw(10) << tenants
+                  << std::setw(14) << std::fixed << std::setprecision(1) << nanos / ops
+                  << std::setw(17) << 100.0 * realTime / std::max<uint64_t>(bytes, 1) << "%\n";
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+// Decoupled delay and bandwidth: one low-rate real-time flow (a 1500 byte
+// packet every 24 ms, 62.5 KB/s) shares a 10 Mbit/s link with ten greedy
+// bulk flows, in virtual time. Rate-based schedulers tie the real-time
+// flow's delay to its rate (WF2Q+ bounds it by L / r = 24 ms plus a packet);
+// HFSC's concave curve (1500 bytes within 5 ms, then 62.5 KB/s) bounds it
+// by 5 ms plus one packet on the link, without giving the flow more
+// bandwidth.
+void benchHfscDelay() {
+    using Curve = HfscQueue::ServiceCurve;
+    const uint64_t link = 1250000;          // 10 Mbit/s
+    const uint64_t rtRate = 62500;
+    const uint32_t packetSize = 1500;
+    const uint32_t bulkFlows = 10;
+    const int64_t period = packetSize * 1000000000LL / static_cast<int64_t>(rtRate);
+    const int64_t end = 20LL * 1000000000LL;
+
+    std::cout << "Real-time flow at 62.5 KB/s against 10 greedy flows, 10 Mbit/s link\n";
+    std::cout << std::setw(10) << "Scheduler" << std::setw(20) << "Worst delay (ms)"
+              << std::setw(20) << "Mean delay (ms)" << std::setw(18) << "RT rate (KB/s)" << "\n";
+    std::cout << std::string(68, '-') << "\n";
+
+    for (const std::string name : {"WF2Q+", "HFSC"}) {
+        std::shared_ptr<QueueDiscipline> queue;
+        std::shared_ptr<HfscQueue> hfsc;
+        if (name == "HFSC") {
+            hfsc = std::make_shared<HfscQueue>(1000);
+            uint32_t rt = hfsc->addClass(HfscQueue::kRoot,
+                                         Curve::fromDelay(packetSize, std::chrono::milliseconds(5),
+                                                          rtRate),
+                                         Curve::linear(rtRate));
+            hfsc->assignFlow(0, rt);
+            for (uint32_t id = 1; id <= bulkFlows; id++) {
+                hfsc->assignFlow(id, hfsc->addClass(HfscQueue::kRoot, Curve(),
+                                                    Curve::linear((link - rtRate) / bulkFlows)));
+            }
+            queue = hfsc;
+        } else {
+            auto wf2q = std::make_shared<Wf2qQueue>(link, 1000);
+            wf2q->setRate(0, rtRate);
+            for (uint32_t id = 1; id <= bulkFlows; id++) {
+                wf2q->setRate(id, (link - rtRate) / bulkFlows);
+            }
+            queue = wf2q;
+        }
+        auto enqueue = [&](std::shared_ptr<Packet> packet, int64_t now) {
+            return hfsc ? hfsc->enqueueAt(std::move(packet), now)
+                        : queue->enqueue(std::move(packet));
+        };
+        auto dequeue = [&](int64_t now) {
+            return hfsc ? hfsc->tryDequeueAt(now) : queue->tryDequeue();
+        };
+
+        int64_t now = 0;
+        for (uint32_t id = 1; id <= bulkFlows; id++) {
+            for (int i = 0; i < 4; i++) {
+                enqueue(std::make_shared<Packet>(id, packetSize), now);
+            }
+        }
+        std::deque<int64_t> arrivals;
+        int64_t nextArrival = period / 3;
+        double worst = 0.0;
+        double sum = 0.0;
+        uint64_t sent = 0;
+        while (now < end) {
+            while (nextArrival <= now) {
+                enqueue(std::make_shared<Packet>(0, packetSize), nextArrival);
+                arrivals.push_back(nextArrival);
+                nextArrival += period;
+            }
+            auto packet = dequeue(now);
+            if (!packet) {
+                now = nextArrival;
+                continue;
+            }
+            now += packet->getSize() * 1000000000LL / static_cast<int64_t>(link);
+            if (packet->getFlowId() == 0) {
+                double delay = (now - arrivals.front()) / 1e6;
+                arrivals.pop_front();
+                worst = std::max(worst, delay);
+                sum += delay;
+                sent++;
+            } else {
+                enqueue(std::move(packet), now);
+            }
+        }
+        std::cout << std::setw(10) << name << std::setw(20) << std::fixed << std::setprecision(2)
+                  << worst << std::setw(20) << sum / std::max<uint64_t>(sent, 1)
+                  << std::setw(18) << std::setprecision(1)
+                  << sent * packetSize / (end / 1e9) / 1000.0 << "\n";
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+// Packets per second through 'threads' TX threads. Thread i keeps its flows
+// backlogged: it dequeues from txQueue(i), pays the shared limiter if there
+// is one, and puts the packet back through 'front'.
+double runTxThreads(size_t threads, uint64_t perThread,
+                    const std::vector<std::vector<uint32_t>>& flowsOf,
+                    QueueDiscipline& front,
+                    const std::function<QueueDiscipline&(size_t)>& txQueue,
+                    RateLimiter* limiter) {
+    for (size_t t = 0; t < threads; t++) {
+        for (uint32_t id : flowsOf[t]) {
+            for (int i = 0; i < 4; i++) {
+                front.enqueue(std::make_shared<Packet>(id, 64 + id % 1437));
+            }
+        }
+    }
+
+    std::atomic<size_t> ready{0};
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            ready++;
+            while (ready.load() < threads) {
+                std::this_thread::yield();
+            }
+            QueueDiscipline& queue = txQueue(t);
+            for (uint64_t i = 0; i < perThread; i++) {
+                auto packet = queue.tryDequeue();
+                if (!packet) {
+                    continue;
+                }
+                if (limiter) {
+                    limiter->consume(packet->getSize());
+                }
+                front.enqueue(std::move(packet));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(threads * perThread) / seconds;
+}
+
+// RSS-style TX scaling. Every thread drives 256 backlogged flows. With one
+// shared DRR queue all threads contend for its lock (and a flow's packets
+// can leave out of order); with a MultiQueueDiscipline each thread owns the
+// DRR queue its flows hash to. Efficiency is the TX-queue rate over N times
+// the one-thread rate. The last two columns add a shared aggregate limiter,
+// with a rate high enough never to refuse a packet.
+void benchTxScaling(uint64_t operations) {
+    const uint32_t flowsPerThread = 256;
+    const uint64_t perThread = std::max<uint64_t>(operations / 16, 10000);
+    const uint64_t rate = 1ULL << 40;
+    const uint64_t bucket = 1ULL << 31;
+
+    std::cout << "TX threads over one shared queue vs one TX queue each, "
+              << std::thread::hardware_concurrency() << " hardware threads\n";
+    std::cout << std::setw(8) << "Threads" << std::setw(16) << "Shared (Mpps)"
+              << std::setw(16) << "TX queues" << std::setw(12) << "Efficiency"
+              << std::setw(16) << "+TokenBucket" << std::setw(16) << "+Sharded TB" << "\n";
+    std::cout << std::string(84, '-') << "\n";
+
+    double single = 0.0;
+    for (size_t threads : {1, 2, 4, 8, 16}) {
+        // The first flow ids that hash to each TX queue
+        std::vector<std::vector<uint32_t>> flowsOf(threads);
+        for (uint32_t id = 0, placed = 0; placed < threads * flowsPerThread; id++) {
+            auto& flows = flowsOf[MultiQueueDiscipline::queueFor(id, threads)];
+            if (flows.size() < flowsPerThread) {
+                flows.push_back(id);
+                placed++;
+            }
+        }
+        size_t capacity = static_cast<size_t>(flowsPerThread) * 4;
+
+        auto shared = std::make_shared<DrrQueue>(capacity * threads);
+        double sharedRate = runTxThreads(threads, perThread, flowsOf, *shared,
+                                         [&](size_t) -> QueueDiscipline& { return *shared; },
+                                         nullptr);
+
+        auto makeTxQueues = [&] {
+            std::vector<std::shared_ptr<QueueDiscipline>> queues;
+            for (size_t t = 0; t < threads; t++) {
+                queues.push_back(std::make_shared<DrrQueue>(capacity));
+            }
+            return std::make_shared<MultiQueueDiscipline>(std::move(queues));
+        };
+        auto runTxQueues = [&](RateLimiter* limiter) {
+            auto txQueues = makeTxQueues();
+            return runTxThreads(threads, perThread, flowsOf, *txQueues,
+                                [&](size_t t) -> QueueDiscipline& { return *txQueues->getQueue(t); },
+                                limiter);
+        };
+        double txRate = runTxQueues(nullptr);
+        TokenBucket tokenBucket(rate, bucket);
+        double tokenBucketRate = runTxQueues(&tokenBucket);
+        ShardedTokenBucket shardedBucket(rate, bucket, 16);
+        double shardedRate = runTxQueues(&shardedBucket);
+
+        if (threads == 1) {
+            single = txRate;
+        }
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2)
+                  << std::setw(16) << sharedRate / 1e6 << std::setw(16) << txRate / 1e6
+                  << std::setw(11) << std::setprecision(0) << 100.0 * txRate / (threads * single)
+                  << "%" << std::setprecision(2) << std::setw(16) << tokenBucketRate / 1e6
+                  << std::setw(16) << shardedRate / 1e6 << "\n";
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+// TrafficShaper's own loop at 10 Gbit/s with a backlog of 1500 byte packets
+// from 16 flows and a bucket that never runs dry, so the shaper's clock
+// reads, limiter calls, sleeps and statistics are the only limit. One
+// sleep per packet costs far more than a 1.2 us serialization time; a batch
+// pays it once.
+void benchShaperBatching() {
+    const uint64_t link = 10000000000ULL;   // bits per second
+    const size_t backlog = 400000;
+    const auto duration = std::chrono::milliseconds(500);
+
+    std::cout << "TrafficShaper at 10 Gbit/s, 1500 byte packets, 16 flows, "
+              << duration.count() << " ms per run\n";
+    std::cout << std::setw(8) << "Batch" << std::setw(12) << "Mpps"
+              << std::setw(14) << "Link use" << "\n";
+    std::cout << std::string(34, '-') << "\n";
+
+    for (size_t batch : {1, 4, 16, 64}) {
+        auto queue = std::make_shared<PacketQueue>(backlog);
+        std::vector<std::shared_ptr<Flow>> flows;
+        for (uint32_t id = 0; id < 16; id++) {
+            flows.push_back(std::make_shared<Flow>(id, FlowType::CONSTANT_RATE, link / 128));
+        }
+        for (size_t i = 0; i < backlog; i++) {
+            queue->enqueue(std::make_shared<Packet>(static_cast<uint32_t>(i % 16), 1500));
+        }
+
+        TrafficShaper shaper(queue, std::make_shared<TokenBucket>(1ULL << 40, 1ULL << 31), link);
+        shaper.setBatchSize(batch);
+        for (const auto& flow : flows) {
+            shaper.addFlow(flow);
+        }
+        auto start = std::chrono::steady_clock::now();
+        shaper.start();
+        std::this_thread::sleep_for(duration);
+        shaper.stop();
+        double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        uint64_t packets = shaper.getPacketsTransmitted();
+        std::cout << std::setw(8) << batch << std::fixed << std::setprecision(3)
+                  << std::setw(12) << packets / seconds / 1e6 << std::setw(13)
+                  << std::setprecision(1) << 100.0 * shaper.getBytesTransmitted() * 8 / seconds / link
+                  << "%\n";
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t operations = 5000000;
+    if (argc > 1) {
+        operations = std::strtoull(argv[1], nullptr, 10);
+    }
+
+    benchBacklogged(operations);
+    benchDelayBound();
+    benchSfqFairness();
+    benchPacing(operations);
+    benchPifo(operations);
+    benchHfscCost(operations);
+    benchHfscDelay();
+    benchTxScaling(operations);
+    benchShaperBatching();
+    return 0;
+}
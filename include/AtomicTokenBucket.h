@@ -0,0 +1,114 @@
+#ifndef ATOMIC_TOKEN_BUCKET_H
+#define ATOMIC_TOKEN_BUCKET_H
+
+#include "RateLimiter.h"
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+// Lock-free token bucket: the token count and the last refill time are
+// packed into one 64-bit word and updated with compare-and-swap, so several
+// shaper threads or policers can share a bucket without a mutex.
+//
+// Layout: [ tokens : 32 | last update : 32 ], time in microseconds on the
+// caller's timeline (nowNs / 1000). The 32-bit time wraps every ~71 minutes;
+// to stay correct across long idle periods the full 64-bit time of the last
+// update is kept alongside (written by whichever thread wins the CAS) and
+// used whenever the gap is too large to read from the packed field.
+// Bucket size is limited to 4 GB.
+class AtomicTokenBucket : public RateLimiter {
+public:
+    AtomicTokenBucket(uint64_t rate, uint64_t bucketSize)
+        : rate_(rate > 0 ? rate : 1)                                // bytes/sec
+        , bucketSize_(std::min<uint64_t>(bucketSize, UINT32_MAX))  // bytes
+        , fillTimeMicros_((bucketSize_ * 1000000ULL) / rate_ + 1)
+        , state_(pack(bucketSize_, 0))                             // Start full
+        , lastUpdateMicros_(0) {}
+
+    bool consumeAt(uint32_t tokens, uint64_t nowNs) override {
+        uint64_t now = nowNs / 1000;
+        uint64_t state = state_.load(std::memory_order_acquire);
+        while (true) {
+            Refill refill = refilled(state, now);
+            if (refill.tokens < tokens) {
+                return false;
+            }
+            uint64_t next = pack(refill.tokens - tokens, refill.time);
+            if (state_.compare_exchange_weak(state, next, std::memory_order_acq_rel,
+                                             std::memory_order_acquire)) {
+                lastUpdateMicros_.store(now, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+
+    uint64_t nanosUntilAvailableAt(uint32_t tokens, uint64_t nowNs) override {
+        uint64_t available = getTokensAt(nowNs);
+        if (available >= tokens) {
+            return 0;
+        }
+        return ((tokens - available) * 1000000000ULL + rate_ - 1) / rate_;
+    }
+
+    // Current token count (refill is computed, not stored)
+    uint64_t getTokensAt(uint64_t nowNs) override {
+        return refilled(state_.load(std::memory_order_acquire), nowNs / 1000).tokens;
+    }
+
+    uint64_t getRate() const override { return rate_; }
+    uint64_t getBucketSize() const override { return bucketSize_; }
+
+private:
+    struct Refill {
+        uint64_t tokens;
+        uint32_t time;   // Packed timestamp to store with the new count
+    };
+
+    static uint64_t pack(uint64_t tokens, uint32_t timeMicros) {
+        return (tokens << 32) | timeMicros;
+    }
+
+    // Token count of a packed state refilled up to 'now'
+    Refill refilled(uint64_t state, uint64_t now) const {
+        uint64_t tokens = state >> 32;
+        uint32_t last = static_cast<uint32_t>(state);
+
+        uint64_t elapsed;
+        bool longIdle = false;
+        uint64_t lastFull = lastUpdateMicros_.load(std::memory_order_relaxed);
+        if (now > lastFull && now - lastFull >= (1ULL << 31)) {
+            elapsed = now - lastFull;  // Packed time may have wrapped
+            longIdle = true;
+        } else {
+            int32_t delta = static_cast<int32_t>(static_cast<uint32_t>(now) - last);
+            // Negative when another thread stored a later time after we read
+            // the clock; treat as no elapsed time and keep its timestamp
+            if (delta <= 0) {
+                return {tokens, last};
+            }
+            elapsed = static_cast<uint64_t>(delta);
+        }
+
+        if (elapsed >= fillTimeMicros_) {
+            return {bucketSize_, static_cast<uint32_t>(now)};
+        }
+
+        uint64_t added = (rate_ * elapsed) / 1000000;
+        if (longIdle || tokens + added >= bucketSize_) {
+            return {std::min(tokens + added, bucketSize_), static_cast<uint32_t>(now)};
+        }
+        // Advance the timestamp only by the time the whole tokens took, so
+        // the fractional remainder carries into the next refill
+        uint32_t spent = static_cast<uint32_t>((added * 1000000 + rate_ - 1) / rate_);
+        return {tokens + added, last + spent};
+    }
+
+    uint64_t rate_;            // Token generation rate (bytes/sec)
+    uint64_t bucketSize_;      // Maximum bucket capacity
+    uint64_t fillTimeMicros_;  // Time to refill an empty bucket
+
+    alignas(64) std::atomic<uint64_t> state_;
+    std::atomic<uint64_t> lastUpdateMicros_;  // Same cache line as state_
+};
+
+#endif // ATOMIC_TOKEN_BUCKET_H
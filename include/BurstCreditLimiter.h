@@ -0,0 +1,70 @@
+#ifndef BURST_CREDIT_LIMITER_H
+#define BURST_CREDIT_LIMITER_H
+
+#include "RateLimiter.h"
+#include "TatBucket.h"
+#include <cstdint>
+#include <algorithm>
+
+// Burstable link in the style of cloud burstable instances. The link earns
+// credit at its baseline rate and spends it on every byte sent, so running
+// below baseline banks credit (up to maxCredits) and running above it draws
+// the balance down. While credit remains the link may send at up to the
+// burst rate; once it is spent the link is held to baseline.
+//
+// The credit balance is a TatBucket sized in bytes at the baseline rate, and
+// the burst ceiling a second, short one at the burst rate. Both are closed
+// form in the elapsed time: nothing accrues per tick, so an idle gap of
+// hours costs the same as one of microseconds and virtual-time runs over
+// simulated days are bounded by the number of packets.
+class BurstCreditLimiter : public RateLimiter {
+public:
+    // Rates in bytes/sec, credits in bytes. 'initialCredits' defaults to a
+    // full balance; 'burstSize' (the burst-rate bucket) defaults to 1 ms at
+    // the burst rate, and at least 64 KB so a large segment always fits.
+    BurstCreditLimiter(uint64_t baselineRate, uint64_t burstRate, uint64_t maxCredits,
+                       uint64_t initialCredits = UINT64_MAX, uint64_t burstSize = 0)
+        : credits_(baselineRate, maxCredits, initialCredits)
+        , ceiling_(std::max(burstRate, baselineRate),
+                   burstSize > 0 ? burstSize : std::max<uint64_t>(burstRate / 1000, 65536)) {}
+
+    bool consumeAt(uint32_t tokens, uint64_t nowNs) override {
+        if (!credits_.consumeAt(tokens, nowNs)) {
+            return false;
+        }
+        if (!ceiling_.consumeAt(tokens, nowNs)) {
+            credits_.refundAt(tokens, nowNs);
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t nanosUntilAvailableAt(uint32_t tokens, uint64_t nowNs) override {
+        return std::max(credits_.nanosUntilAt(tokens, nowNs),
+                        ceiling_.nanosUntilAt(tokens, nowNs));
+    }
+
+    // Bytes sendable right now: the smaller of the balance and the ceiling
+    uint64_t getTokensAt(uint64_t nowNs) override {
+        return std::min(credits_.tokensAt(nowNs), ceiling_.tokensAt(nowNs));
+    }
+
+    // Banked credit in bytes
+    uint64_t getCreditsAt(uint64_t nowNs) const {
+        return credits_.tokensAt(nowNs);
+    }
+
+    uint64_t getRate() const override { return credits_.getRate(); }
+    uint64_t getBucketSize() const override { return credits_.getBurst(); }
+    uint64_t getMaxPacketSize() const override {
+        return std::min(credits_.getBurst(), ceiling_.getBurst());
+    }
+    uint64_t getBurstRate() const { return ceiling_.getRate(); }
+    uint64_t getMaxCredits() const { return credits_.getBurst(); }
+
+private:
+    TatBucket credits_;     // Earns at baseline, holds up to maxCredits
+    TatBucket ceiling_;     // Caps the send rate at the burst rate
+};
+
+#endif // BURST_CREDIT_LIMITER_H
@@ -0,0 +1,109 @@
+#ifndef COLOR_MARKER_H
+#define COLOR_MARKER_H
+
+#include "Packet.h"
+#include "RateLimiter.h"
+#include "TatBucket.h"
+#include <cstdint>
+#include <algorithm>
+
+// Three-color markers for ingress policing. A marker colors each packet
+// green, yellow or red against its contract and tags the packet, so a
+// policer can drop red and downstream stages can treat yellow as
+// drop-eligible. Color-blind markers ignore the packet's existing color;
+// color-aware ones never upgrade it (a yellow packet cannot become green).
+//
+// The buckets are TatBuckets: marking is lock-free, and mark() reads the
+// clock once per packet.
+class ColorMarker {
+public:
+    explicit ColorMarker(bool colorAware)
+        : colorAware_(colorAware) {}
+
+    virtual ~ColorMarker() = default;
+
+    // Color the packet and tag it with the result
+    PacketColor mark(Packet& packet) {
+        return markAt(packet, RateLimiter::nowNanos());
+    }
+
+    PacketColor markAt(Packet& packet, uint64_t nowNs) {
+        PacketColor incoming = colorAware_ ? packet.getColor() : PacketColor::GREEN;
+        PacketColor color = colorAt(packet.getSize(), incoming, nowNs);
+        packet.setColor(color);
+        return color;
+    }
+
+    // Color for a packet of 'bytes' that arrived with color 'incoming'
+    virtual PacketColor colorAt(uint32_t bytes, PacketColor incoming, uint64_t nowNs) = 0;
+
+    bool isColorAware() const { return colorAware_; }
+
+private:
+    bool colorAware_;
+};
+
+// Single-rate three-color marker (RFC 2697). Committed bucket C (CBS) and
+// excess bucket E (EBS) both fill at CIR, C first; E receives only what
+// overflows from C. Green if C holds the packet, else yellow if E does, else
+// red.
+//
+// Tokens are never lost between C and E until both are full, so E's content
+// equals T - C where T is a single bucket of CBS + EBS at CIR debited by
+// every green or yellow packet. That keeps each bucket a single TAT word.
+class SrTcmMarker : public ColorMarker {
+public:
+    SrTcmMarker(uint64_t cir, uint64_t cbs, uint64_t ebs, bool colorAware = false)
+        : ColorMarker(colorAware)
+        , committed_(cir, cbs)
+        , total_(cir, cbs + ebs) {}
+
+    PacketColor colorAt(uint32_t bytes, PacketColor incoming, uint64_t nowNs) override {
+        if (incoming == PacketColor::RED) {
+            return PacketColor::RED;
+        }
+        if (incoming == PacketColor::GREEN && committed_.consumeAt(bytes, nowNs)) {
+            total_.forceConsumeAt(bytes, nowNs);  // T >= C, so T holds it too
+            return PacketColor::GREEN;
+        }
+        // Yellow if E = T - C holds the packet
+        int64_t committedCredit = std::max<int64_t>(committed_.creditAt(nowNs), 0);
+        if (total_.consumeAt(bytes, nowNs, committedCredit)) {
+            return PacketColor::YELLOW;
+        }
+        return PacketColor::RED;
+    }
+
+private:
+    TatBucket committed_;
+    TatBucket total_;
+};
+
+// Two-rate three-color marker (RFC 2698). Peak bucket P (PIR, PBS) and
+// committed bucket C (CIR, CBS) fill independently. Red if P cannot hold the
+// packet; otherwise P is debited and the packet is green if C also holds it
+// (and C is debited), yellow if not.
+class TrTcmMarker : public ColorMarker {
+public:
+    TrTcmMarker(uint64_t cir, uint64_t cbs, uint64_t pir, uint64_t pbs,
+                bool colorAware = false)
+        : ColorMarker(colorAware)
+        , committed_(cir, cbs)
+        , peak_(std::max(pir, cir), pbs) {}
+
+    PacketColor colorAt(uint32_t bytes, PacketColor incoming, uint64_t nowNs) override {
+        if (incoming == PacketColor::RED || !peak_.consumeAt(bytes, nowNs)) {
+            return PacketColor::RED;
+        }
+        if (incoming == PacketColor::GREEN && committed_.consumeAt(bytes, nowNs)) {
+            return PacketColor::GREEN;
+        }
+        return PacketColor::YELLOW;
+    }
+
+private:
+    TatBucket committed_;
+    TatBucket peak_;
+};
+
+#endif // COLOR_MARKER_H
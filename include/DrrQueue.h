@@ -0,0 +1,179 @@
+#ifndef DRR_QUEUE_H
+#define DRR_QUEUE_H
+
+#include "QueueDiscipline.h"
+#include "PacketSlotPool.h"
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+// Deficit Round Robin (Shreedhar & Varghese) with a sub-queue per flow.
+// A flow sends head packets while its deficit covers them; when it does not,
+// the flow's quantum is added and it moves to the back of the round. A flow
+// joining the round starts with one quantum. Flows share bytes (not
+// packets) in proportion to their quanta, whatever their packet sizes or
+// priorities.
+//
+// Only backlogged flows are on the active list and a flow leaves it as soon
+// as its queue empties, so idle flows are never visited. With quanta of at
+// least one MTU every dequeue is O(1). Per-flow state is a dense array
+// indexed by slot, with packets in a shared PacketSlotPool, so enqueue and
+// dequeue do not allocate.
+class DrrQueue final : public QueueDiscipline {
+public:
+    static constexpr uint32_t kMtu = 1514;
+
+    DrrQueue(size_t maxSize = 1000, uint32_t defaultQuantum = kMtu)
+        : pool_(maxSize)
+        , activeHead_(PacketSlotPool::kNil)
+        , activeTail_(PacketSlotPool::kNil)
+        , defaultQuantum_(defaultQuantum > 0 ? defaultQuantum : 1)
+        , totalDropped_(0) {}
+
+    // Bytes the flow may send per round; flows not set get the default.
+    // Weights are ratios of quanta.
+    void setQuantum(uint32_t flowId, uint32_t quantum) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flows_[slotFor(flowId)].quantum = quantum > 0 ? quantum : 1;
+    }
+
+    // Tail drop when the shared buffer is full
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        auto now = std::chrono::high_resolution_clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (pool_.full()) {
+            totalDropped_++;
+            return false;
+        }
+
+        packet->setEnqueueTime(now);
+        uint32_t slot = slotFor(packet->getFlowId());
+        FlowState& flow = flows_[slot];
+        pool_.push(flow.packets, std::move(packet));
+        telemetry_.recordEnqueue(pool_.used(), toNanos(now));
+
+        if (!flow.active) {
+            flow.deficit = flow.quantum;
+            pushBack(slot);
+        }
+        return true;
+    }
+
+    std::shared_ptr<Packet> tryDequeue() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = nowNanos();
+
+        auto packet = dequeueLocked();
+        if (packet) {
+            telemetry_.recordDequeue(pool_.used(), now,
+                                     now - toNanos(packet->getEnqueueTime()));
+        } else {
+            telemetry_.recordOccupancy(pool_.used(), now);
+        }
+        return packet;
+    }
+
+    size_t size() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used();
+    }
+
+    bool empty() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used() == 0;
+    }
+
+    size_t getTotalDropped() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return totalDropped_;
+    }
+
+    // Flows that have ever had a quantum set or sent a packet
+    size_t getNumFlows() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return flows_.size();
+    }
+
+private:
+    struct FlowState {
+        PacketSlotPool::List packets;
+        int64_t deficit = 0;
+        uint32_t quantum = 0;
+        uint32_t nextActive = PacketSlotPool::kNil;
+        bool active = false;
+    };
+
+    uint32_t slotFor(uint32_t flowId) {
+        auto it = slots_.find(flowId);
+        if (it != slots_.end()) {
+            return it->second;
+        }
+        uint32_t slot = static_cast<uint32_t>(flows_.size());
+        slots_.emplace(flowId, slot);
+        flows_.emplace_back();
+        flows_.back().quantum = defaultQuantum_;
+        return slot;
+    }
+
+    std::shared_ptr<Packet> dequeueLocked() {
+        while (activeHead_ != PacketSlotPool::kNil) {
+            uint32_t slot = activeHead_;
+            FlowState& flow = flows_[slot];
+
+            uint32_t headSize = pool_.front(flow.packets)->getSize();
+            if (flow.deficit < headSize) {
+                // Start this flow's next turn at the back of the round
+                flow.deficit += flow.quantum;
+                popFront();
+                pushBack(slot);
+                continue;
+            }
+
+            auto packet = pool_.pop(flow.packets);
+            flow.deficit -= packet->getSize();
+            if (flow.packets.empty()) {
+                // Credit does not survive an idle period
+                popFront();
+                flow.active = false;
+            }
+            return packet;
+        }
+        return nullptr;
+    }
+
+    void pushBack(uint32_t slot) {
+        FlowState& flow = flows_[slot];
+        flow.nextActive = PacketSlotPool::kNil;
+        flow.active = true;
+        if (activeHead_ == PacketSlotPool::kNil) {
+            activeHead_ = slot;
+        } else {
+            flows_[activeTail_].nextActive = slot;
+        }
+        activeTail_ = slot;
+    }
+
+    void popFront() {
+        uint32_t slot = activeHead_;
+        activeHead_ = flows_[slot].nextActive;
+        if (activeHead_ == PacketSlotPool::kNil) {
+            activeTail_ = PacketSlotPool::kNil;
+        }
+        flows_[slot].nextActive = PacketSlotPool::kNil;
+    }
+
+    PacketSlotPool pool_;
+    std::unordered_map<uint32_t, uint32_t> slots_;  // Flow id -> slot
+    std::vector<FlowState> flows_;
+    uint32_t activeHead_;       // Backlogged flows, in round order
+    uint32_t activeTail_;
+    uint32_t defaultQuantum_;
+
+    size_t totalDropped_;
+    mutable std::mutex mutex_;
+};
+
+#endif // DRR_QUEUE_H
@@ -0,0 +1,181 @@
+#ifndef EDF_QUEUE_H
+#define EDF_QUEUE_H
+
+#include "QueueDiscipline.h"
+#include "PacketSlotPool.h"
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <utility>
+#include <cstdint>
+
+// Earliest Deadline First across flows. Each flow has a latency budget and
+// each packet's deadline is its creation time plus its flow's budget; the
+// packet with the earliest deadline is sent first.
+//
+// A flow's packets are created in order and share one budget, so their
+// deadlines increase along the flow's FIFO and only the head packet of each
+// backlogged flow needs to be in the deadline heap: O(log flows) per packet.
+// Because the head of the heap is the earliest deadline of all, a single
+// comparison at dequeue tells whether anything is late. Late packets are
+// counted as deadline misses and, with setDropLate(true), dropped instead
+// of spending tokens on them.
+class EdfQueue final : public QueueDiscipline {
+public:
+    EdfQueue(size_t maxSize = 1000,
+             std::chrono::microseconds defaultBudget = std::chrono::seconds(1))
+        : pool_(maxSize)
+        , defaultBudget_(std::chrono::duration_cast<std::chrono::nanoseconds>(
+              defaultBudget).count())
+        , dropLate_(false)
+        , deadlineMisses_(0)
+        , lateDrops_(0)
+        , totalDropped_(0) {}
+
+    // Latency budget of a flow; flows not set get the default
+    void setBudget(uint32_t flowId, std::chrono::microseconds budget) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flows_[slotFor(flowId)].budget =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(budget).count();
+    }
+
+    // Drop packets whose deadline has already passed at dequeue
+    void setDropLate(bool enabled) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        dropLate_ = enabled;
+    }
+
+    // Tail drop when the shared buffer is full
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        auto now = std::chrono::high_resolution_clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (pool_.full()) {
+            totalDropped_++;
+            return false;
+        }
+
+        packet->setEnqueueTime(now);
+        uint32_t slot = slotFor(packet->getFlowId());
+        FlowState& flow = flows_[slot];
+        bool wasIdle = flow.packets.empty();
+        pool_.push(flow.packets, std::move(packet));
+        telemetry_.recordEnqueue(pool_.used(), toNanos(now));
+
+        if (wasIdle) {
+            deadlines_.emplace(headDeadline(flow), slot);
+        }
+        return true;
+    }
+
+    // Earliest-deadline packet; late ones are counted, and dropped if so set
+    std::shared_ptr<Packet> tryDequeue() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = nowNanos();
+
+        while (!deadlines_.empty()) {
+            int64_t deadline = deadlines_.top().first;
+            uint32_t slot = deadlines_.top().second;
+            deadlines_.pop();
+
+            FlowState& flow = flows_[slot];
+            auto packet = pool_.pop(flow.packets);
+            if (!flow.packets.empty()) {
+                deadlines_.emplace(headDeadline(flow), slot);
+            }
+
+            if (deadline < now) {
+                deadlineMisses_++;
+                flow.misses++;
+                if (dropLate_) {
+                    lateDrops_++;
+                    totalDropped_++;
+                    packet->markDropped();
+                    notifyDrop(*packet);
+                    continue;
+                }
+            }
+            telemetry_.recordDequeue(pool_.used(), now,
+                                     now - toNanos(packet->getEnqueueTime()));
+            return packet;
+        }
+        telemetry_.recordOccupancy(pool_.used(), now);
+        return nullptr;
+    }
+
+    size_t size() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used();
+    }
+
+    bool empty() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used() == 0;
+    }
+
+    size_t getTotalDropped() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return totalDropped_;
+    }
+
+    // Packets already past their deadline when dequeued (including drops)
+    uint64_t getDeadlineMisses() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return deadlineMisses_;
+    }
+
+    uint64_t getDeadlineMisses(uint32_t flowId) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = slots_.find(flowId);
+        return it != slots_.end() ? flows_[it->second].misses : 0;
+    }
+
+    uint64_t getLateDrops() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return lateDrops_;
+    }
+
+private:
+    using HeapEntry = std::pair<int64_t, uint32_t>;   // Deadline (ns), slot
+    using MinHeap = std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+                                        std::greater<HeapEntry>>;
+
+    struct FlowState {
+        PacketSlotPool::List packets;
+        int64_t budget = 0;     // ns
+        uint64_t misses = 0;
+    };
+
+    uint32_t slotFor(uint32_t flowId) {
+        auto it = slots_.find(flowId);
+        if (it != slots_.end()) {
+            return it->second;
+        }
+        uint32_t slot = static_cast<uint32_t>(flows_.size());
+        slots_.emplace(flowId, slot);
+        flows_.emplace_back();
+        flows_.back().budget = defaultBudget_;
+        return slot;
+    }
+
+    int64_t headDeadline(const FlowState& flow) const {
+        return toNanos(pool_.front(flow.packets)->getCreationTime()) + flow.budget;
+    }
+
+    PacketSlotPool pool_;
+    std::unordered_map<uint32_t, uint32_t> slots_;  // Flow id -> slot
+    std::vector<FlowState> flows_;
+    MinHeap deadlines_;       // Head deadline of each backlogged flow
+    int64_t defaultBudget_;   // ns
+    bool dropLate_;
+
+    uint64_t deadlineMisses_;
+    uint64_t lateDrops_;
+    size_t totalDropped_;
+    mutable std::mutex mutex_;
+};
+
+#endif // EDF_QUEUE_H
@@ -0,0 +1,66 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <cstdint>
+
+// Fixed-point helpers for the rate limiters' hot paths: rates are stored as
+// precomputed scaled multipliers so refills need a multiply and a shift
+// instead of a division.
+namespace FixedPoint {
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 uint128;
+#endif
+
+// (a * b) >> shift with a full 128-bit intermediate product. The caller
+// guarantees that the result fits in 64 bits.
+inline uint64_t mulShr(uint64_t a, uint64_t b, unsigned shift) {
+#if defined(__SIZEOF_INT128__)
+    return static_cast<uint64_t>((static_cast<uint128>(a) * b) >> shift);
+#else
+    uint64_t aLo = a & 0xffffffffULL, aHi = a >> 32;
+    uint64_t bLo = b & 0xffffffffULL, bHi = b >> 32;
+
+    uint64_t loLo = aLo * bLo;
+    uint64_t hiLo = aHi * bLo;
+    uint64_t loHi = aLo * bHi;
+    uint64_t hiHi = aHi * bHi;
+
+    uint64_t cross = (loLo >> 32) + (hiLo & 0xffffffffULL) + loHi;
+    uint64_t lo = (cross << 32) | (loLo & 0xffffffffULL);
+    uint64_t hi = hiHi + (hiLo >> 32) + (cross >> 32);
+
+    if (shift == 0) return lo;
+    if (shift >= 64) return hi >> (shift - 64);
+    return (hi << (64 - shift)) | (lo >> shift);
+#endif
+}
+
+// (a * b + carry) >> shift, leaving the low 'shift' bits in carry so that
+// repeated calls lose no precision (carry < 2^shift, shift < 64)
+inline uint64_t mulShrCarry(uint64_t a, uint64_t b, unsigned shift, uint64_t& carry) {
+    uint64_t mask = (1ULL << shift) - 1;
+#if defined(__SIZEOF_INT128__)
+    uint128 product = static_cast<uint128>(a) * b + carry;
+    carry = static_cast<uint64_t>(product) & mask;
+    return static_cast<uint64_t>(product >> shift);
+#else
+    uint64_t low = a * b;  // Low 64 bits of the product
+    uint64_t result = mulShr(a, b, shift);
+    uint64_t fraction = (low & mask) + carry;
+    carry = fraction & mask;
+    return result + (fraction >> shift);
+#endif
+}
+
+// round(value * 2^shift / divisor), computed once at configuration time
+inline uint64_t scaledRatio(uint64_t value, uint64_t divisor, unsigned shift) {
+    long double scaled = static_cast<long double>(value) *
+                         static_cast<long double>(1ULL << shift) /
+                         static_cast<long double>(divisor);
+    return static_cast<uint64_t>(scaled + 0.5L);
+}
+
+} // namespace FixedPoint
+
+#endif // FIXED_POINT_H
@@ -5,6 +5,8 @@
 #include <string>
 #include <atomic>
 #include <random>
+#include <chrono>
+#include <algorithm>
 
 enum class FlowType {
     CONSTANT_RATE,    // Constant bit rate
@@ -21,10 +23,19 @@ public:
         , targetRate_(targetRate)  // Target rate in bytes/sec
         , priority_(priority)
         , active_(true)
+        , ecnCapable_(false)
+        , sendingRate_(targetRate)
+        , lastRateReduction_(0)
         , packetsSent_(0)
         , packetsDropped_(0)
         , bytesTransmitted_(0)
         , totalDelay_(0.0)
+        , packetsMarked_(0)
+        , latencyBudget_(0)
+        , deadlineMisses_(0)
+        , minPacketSize_(64)
+        , maxPacketSize_(1500)
+        , meanPacketSize_(500)
         , generator_(std::random_device{}()) {}
 
     uint32_t getFlowId() const { return flowId_; }
@@ -32,72 +43,160 @@ public:
     uint64_t getTargetRate() const { return targetRate_; }
     PacketPriority getPriority() const { return priority_; }
     bool isActive() const { return active_; }
+    bool isEcnCapable() const { return ecnCapable_; }
+    // Current sending rate; below target while reacting to ECN marks
+    uint64_t getSendingRate() const { return sendingRate_; }
 
     void setActive(bool active) { active_ = active; }
+    void setEcnCapable(bool capable) { ecnCapable_ = capable; }
+
+    // Latency SLA: packets should be transmitted within this time of their
+    // creation (0: none). Deadline schedulers order packets by it, and
+    // transmissions later than it count as deadline misses. Must be set
+    // before traffic starts.
+    void setLatencyBudget(std::chrono::microseconds budget) { latencyBudget_ = budget; }
+    std::chrono::microseconds getLatencyBudget() const { return latencyBudget_; }
+
+    // Size range of generated packets; inter-arrival times then pace the
+    // range's mean size at the target rate. By default sizes are 64-1500
+    // bytes paced as 500-byte packets. Must be set before traffic starts.
+    void setPacketSizeRange(uint32_t minSize, uint32_t maxSize) {
+        minPacketSize_ = std::max<uint32_t>(minSize, 1);
+        maxPacketSize_ = std::max(maxSize, minPacketSize_);
+        meanPacketSize_ = (minPacketSize_ + maxPacketSize_) / 2;
+    }
+
+    Packet generatePacket() {
+        return generatePacket(minPacketSize_, maxPacketSize_);
+    }
+
+    uint64_t getInterArrivalTime() {
+        return getInterArrivalTime(meanPacketSize_);
+    }
     
     // Generate next packet based on flow type
-    Packet generatePacket(uint32_t minSize = 64, uint32_t maxSize = 1500) {
+    Packet generatePacket(uint32_t minSize, uint32_t maxSize) {
         packetsSent_++;
         
         std::uniform_int_distribution<uint32_t> sizeDist(minSize, maxSize);
         uint32_t packetSize = sizeDist(generator_);
         
-        return Packet(flowId_, packetSize, priority_);
+        Packet packet(flowId_, packetSize, priority_);
+        packet.setEcnCapable(ecnCapable_);
+        return packet;
     }
 
     // Get inter-arrival time in microseconds based on flow type
-    uint64_t getInterArrivalTime(uint32_t avgPacketSize = 500) {
+    uint64_t getInterArrivalTime(uint32_t avgPacketSize) {
+        uint64_t rate = sendingRate_;
         switch (type_) {
             case FlowType::CONSTANT_RATE: {
                 // Constant inter-arrival time
-                return (avgPacketSize * 1000000ULL) / targetRate_;
+                return (avgPacketSize * 1000000ULL) / rate;
             }
             case FlowType::BURSTY: {
                 // Alternating between burst and idle periods
                 std::uniform_real_distribution<double> dist(0.0, 1.0);
                 if (dist(generator_) < 0.3) { // 30% chance of burst
-                    return (avgPacketSize * 1000000ULL) / (targetRate_ * 3); // 3x rate
+                    return (avgPacketSize * 1000000ULL) / (rate * 3); // 3x rate
                 } else {
-                    return (avgPacketSize * 1000000ULL) / (targetRate_ / 2); // 0.5x rate
+                    return (avgPacketSize * 1000000ULL) / (rate / 2); // 0.5x rate
                 }
             }
             case FlowType::POISSON: {
                 // Exponentially distributed inter-arrival times
                 std::exponential_distribution<double> dist(
-                    static_cast<double>(targetRate_) / avgPacketSize);
+                    static_cast<double>(rate) / avgPacketSize);
                 return static_cast<uint64_t>(dist(generator_) * 1000000.0);
             }
         }
-        return (avgPacketSize * 1000000ULL) / targetRate_;
+        return (avgPacketSize * 1000000ULL) / rate;
     }
 
     // Statistics
     void recordDrop() { packetsDropped_++; }
     void recordTransmission(uint32_t bytes, double delay) {
+        recordTransmissions(bytes, delay, isLate(delay) ? 1 : 0);
+    }
+
+    // Several transmissions at once: their bytes, summed delay (ms) and how
+    // many were late (see isLate), one atomic update each
+    void recordTransmissions(uint64_t bytes, double totalDelay, uint64_t deadlineMisses) {
         bytesTransmitted_ += bytes;
+        if (deadlineMisses > 0) {
+            deadlineMisses_ += deadlineMisses;
+        }
         double current = totalDelay_.load();
-        while (!totalDelay_.compare_exchange_weak(current, current + delay));
+        while (!totalDelay_.compare_exchange_weak(current, current + totalDelay));
+    }
+
+    // Whether a packet sent 'delay' ms after creation missed the budget
+    bool isLate(double delay) const {
+        return latencyBudget_.count() > 0 && delay * 1000.0 > latencyBudget_.count();
+    }
+
+    // ECN echo seen when a packet of this flow is transmitted. A CE mark
+    // halves the sending rate (at most once per reaction window, floored at
+    // 1/16 of the target); unmarked packets recover it additively by 1% of
+    // the target, much like a TCP sender's AIMD response.
+    void onEcnEcho(bool congestionExperienced) {
+        if (!ecnCapable_) return;
+
+        if (congestionExperienced) {
+            packetsMarked_++;
+            int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            int64_t last = lastRateReduction_.load();
+            if (now - last < kReactionWindowMicros ||
+                !lastRateReduction_.compare_exchange_strong(last, now)) {
+                return;  // Already reacted within this window
+            }
+            uint64_t floor = std::max<uint64_t>(targetRate_ / 16, 1);
+            uint64_t current = sendingRate_.load();
+            while (!sendingRate_.compare_exchange_weak(
+                current, std::max(current / 2, floor)));
+        } else {
+            uint64_t step = std::max<uint64_t>(targetRate_ / 100, 1);
+            uint64_t current = sendingRate_.load();
+            while (current < targetRate_ &&
+                   !sendingRate_.compare_exchange_weak(
+                       current, std::min(current + step, targetRate_)));
+        }
     }
 
     uint64_t getPacketsSent() const { return packetsSent_; }
     uint64_t getPacketsDropped() const { return packetsDropped_; }
     uint64_t getBytesTransmitted() const { return bytesTransmitted_; }
+    uint64_t getPacketsMarked() const { return packetsMarked_; }
+    uint64_t getDeadlineMisses() const { return deadlineMisses_; }
     double getAverageDelay() const {
         uint64_t transmitted = packetsSent_ - packetsDropped_;
         return transmitted > 0 ? totalDelay_ / transmitted : 0.0;
     }
 
 private:
+    static constexpr int64_t kReactionWindowMicros = 100000;  // ~one RTT
+
     uint32_t flowId_;
     FlowType type_;
     uint64_t targetRate_;
     PacketPriority priority_;
     std::atomic<bool> active_;
+    bool ecnCapable_;
+    std::atomic<uint64_t> sendingRate_;       // bytes/sec, <= targetRate_
+    std::atomic<int64_t> lastRateReduction_;  // steady_clock microseconds
     
     std::atomic<uint64_t> packetsSent_;
     std::atomic<uint64_t> packetsDropped_;
     std::atomic<uint64_t> bytesTransmitted_;
     std::atomic<double> totalDelay_;
+    std::atomic<uint64_t> packetsMarked_;
+    std::chrono::microseconds latencyBudget_;
+    std::atomic<uint64_t> deadlineMisses_;   // Transmitted after the budget
+
+    uint32_t minPacketSize_;
+    uint32_t maxPacketSize_;
+    uint32_t meanPacketSize_;   // Size used to pace inter-arrival times
     
     std::mt19937 generator_;
 };
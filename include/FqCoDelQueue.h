@@ -0,0 +1,328 @@
+#ifndef FQ_CODEL_QUEUE_H
+#define FQ_CODEL_QUEUE_H
+
+#include "QueueDiscipline.h"
+#include "PacketSlotPool.h"
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdint>
+
+// FQ-CoDel (RFC 8290): packets are hashed by flow id into a fixed set of
+// sub-queues, served by DRR with separate new/old flow lists, and each
+// sub-queue runs its own CoDel instance (RFC 8289). Sub-queues live in a flat
+// array and share one PacketSlotPool, so the bucket count does not add any
+// per-packet allocation. With ECN marking enabled (the default, as in Linux),
+// ECN-capable packets are CE-marked instead of dropped by CoDel; overflow
+// still drops.
+class FqCoDelQueue final : public QueueDiscipline {
+public:
+    static constexpr uint32_t kMtu = 1514;
+
+    FqCoDelQueue(size_t maxSize = 1000,
+                 size_t numBuckets = 1024,
+                 uint32_t quantum = kMtu,
+                 std::chrono::microseconds target = std::chrono::milliseconds(5),
+                 std::chrono::microseconds interval = std::chrono::milliseconds(100))
+        : pool_(maxSize)
+        , buckets_(numBuckets > 0 ? numBuckets : 1)
+        , quantum_(quantum)
+        , target_(std::chrono::duration_cast<std::chrono::nanoseconds>(target).count())
+        , interval_(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count())
+        , hashSeed_(std::random_device{}())
+        , ecnMarking_(true)
+        , totalDropped_(0)
+        , codelDrops_(0)
+        , overflowDrops_(0)
+        , ecnMarks_(0) {}
+
+    // Always accepts the arriving packet; on overflow the oldest packets of
+    // the fattest sub-queue are dropped instead (reported via drop callback)
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (pool_.capacity() == 0) {
+            totalDropped_++;
+            return false;
+        }
+        if (pool_.full()) {
+            dropFromFattest();
+        }
+
+        auto now = std::chrono::high_resolution_clock::now();
+        packet->setEnqueueTime(now);
+
+        uint32_t index = bucketFor(packet->getFlowId());
+        Bucket& bucket = buckets_[index];
+        pool_.push(bucket.packets, std::move(packet));
+        telemetry_.recordEnqueue(pool_.used(), toNanos(now));
+
+        if (bucket.list == ListId::NONE) {
+            bucket.deficit = quantum_;
+            pushBack(newFlows_, index, ListId::NEW);
+        }
+        return true;
+    }
+
+    std::shared_ptr<Packet> tryDequeue() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = nowNanos();
+
+        auto packet = dequeueLocked(now);
+        if (packet) {
+            telemetry_.recordDequeue(pool_.used(), now,
+                                     now - toNanos(packet->getEnqueueTime()));
+        } else {
+            telemetry_.recordOccupancy(pool_.used(), now);
+        }
+        return packet;
+    }
+
+    size_t size() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used();
+    }
+
+    bool empty() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used() == 0;
+    }
+
+    size_t getTotalDropped() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return totalDropped_;
+    }
+
+    size_t getCoDelDrops() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return codelDrops_;
+    }
+
+    size_t getOverflowDrops() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return overflowDrops_;
+    }
+
+    size_t getEcnMarks() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return ecnMarks_;
+    }
+
+    // Mark ECN-capable packets instead of dropping them in CoDel
+    void setEcnMarking(bool enabled) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ecnMarking_ = enabled;
+    }
+
+    size_t getNumBuckets() const { return buckets_.size(); }
+
+private:
+    enum class ListId : uint8_t { NONE, NEW, OLD };
+
+    struct Bucket {
+        PacketSlotPool::List packets;
+        int64_t deficit = 0;
+        uint32_t nextActive = PacketSlotPool::kNil;
+        ListId list = ListId::NONE;
+
+        // CoDel state
+        int64_t firstAboveTime = 0;
+        int64_t dropNext = 0;
+        uint32_t count = 0;
+        uint32_t lastCount = 0;
+        bool dropping = false;
+    };
+
+    // Intrusive list of bucket indices, linked through Bucket::nextActive
+    struct FlowList {
+        uint32_t head = PacketSlotPool::kNil;
+        uint32_t tail = PacketSlotPool::kNil;
+
+        bool empty() const { return head == PacketSlotPool::kNil; }
+    };
+
+    uint32_t bucketFor(uint32_t flowId) const {
+        // Multiplicative hash, then map onto [0, numBuckets) without a modulo
+        uint32_t hash = (flowId ^ hashSeed_) * 2654435761u;
+        return static_cast<uint32_t>((static_cast<uint64_t>(hash) * buckets_.size()) >> 32);
+    }
+
+    // DRR over the new/old flow lists, CoDel on the chosen sub-queue
+    std::shared_ptr<Packet> dequeueLocked(int64_t now) {
+        while (true) {
+            FlowList& list = !newFlows_.empty() ? newFlows_ : oldFlows_;
+            if (list.empty()) {
+                return nullptr;
+            }
+
+            uint32_t index = list.head;
+            Bucket& bucket = buckets_[index];
+
+            if (bucket.deficit <= 0) {
+                bucket.deficit += quantum_;
+                popFront(list);
+                pushBack(oldFlows_, index, ListId::OLD);
+                continue;
+            }
+
+            auto packet = codelDequeue(bucket, now);
+            if (!packet) {
+                // Empty new flows get one pass through the old list so a
+                // flow cannot stay "new" by draining and refilling quickly
+                popFront(list);
+                if (&list == &newFlows_ && !oldFlows_.empty()) {
+                    pushBack(oldFlows_, index, ListId::OLD);
+                } else {
+                    bucket.list = ListId::NONE;
+                }
+                continue;
+            }
+
+            bucket.deficit -= packet->getSize();
+            return packet;
+        }
+    }
+
+    void pushBack(FlowList& list, uint32_t index, ListId id) {
+        Bucket& bucket = buckets_[index];
+        bucket.nextActive = PacketSlotPool::kNil;
+        bucket.list = id;
+        if (list.empty()) {
+            list.head = index;
+        } else {
+            buckets_[list.tail].nextActive = index;
+        }
+        list.tail = index;
+    }
+
+    void popFront(FlowList& list) {
+        uint32_t index = list.head;
+        list.head = buckets_[index].nextActive;
+        if (list.head == PacketSlotPool::kNil) {
+            list.tail = PacketSlotPool::kNil;
+        }
+        buckets_[index].nextActive = PacketSlotPool::kNil;
+    }
+
+    bool tryMark(const std::shared_ptr<Packet>& packet) {
+        if (!ecnMarking_ || !packet->isEcnCapable()) {
+            return false;
+        }
+        packet->markCongestionExperienced();
+        ecnMarks_++;
+        return true;
+    }
+
+    void dropPacket(std::shared_ptr<Packet> packet) {
+        packet->markDropped();
+        totalDropped_++;
+        notifyDrop(*packet);
+    }
+
+    // Head-drop up to half of the fattest sub-queue (at most 64 packets) so
+    // the O(buckets) scan is amortised over several drops, as Linux does
+    void dropFromFattest() {
+        size_t fattest = 0;
+        for (size_t i = 1; i < buckets_.size(); i++) {
+            if (buckets_[i].packets.bytes > buckets_[fattest].packets.bytes) {
+                fattest = i;
+            }
+        }
+
+        Bucket& bucket = buckets_[fattest];
+        uint64_t threshold = bucket.packets.bytes / 2;
+        uint32_t dropped = 0;
+        do {
+            auto packet = pool_.pop(bucket.packets);
+            if (!packet) break;
+            dropPacket(std::move(packet));
+            overflowDrops_++;
+            dropped++;
+        } while (dropped < 64 && bucket.packets.bytes > threshold);
+    }
+
+    // Pop one packet and update the sojourn-time state (RFC 8289 dodequeue)
+    std::shared_ptr<Packet> doDequeue(Bucket& bucket, int64_t now, bool& okToDrop) {
+        okToDrop = false;
+        auto packet = pool_.pop(bucket.packets);
+        if (!packet) {
+            bucket.firstAboveTime = 0;
+            return nullptr;
+        }
+
+        int64_t sojourn = now - toNanos(packet->getEnqueueTime());
+        if (sojourn < target_ || bucket.packets.bytes <= kMtu) {
+            bucket.firstAboveTime = 0;
+        } else if (bucket.firstAboveTime == 0) {
+            bucket.firstAboveTime = now + interval_;
+        } else if (now >= bucket.firstAboveTime) {
+            okToDrop = true;
+        }
+        return packet;
+    }
+
+    std::shared_ptr<Packet> codelDequeue(Bucket& bucket, int64_t now) {
+        bool okToDrop = false;
+        auto packet = doDequeue(bucket, now, okToDrop);
+
+        if (bucket.dropping) {
+            if (!okToDrop) {
+                bucket.dropping = false;
+            }
+            while (bucket.dropping && now >= bucket.dropNext) {
+                bucket.count++;
+                if (tryMark(packet)) {
+                    bucket.dropNext = controlLaw(bucket.dropNext, bucket.count);
+                    break;
+                }
+                dropPacket(std::move(packet));
+                codelDrops_++;
+                packet = doDequeue(bucket, now, okToDrop);
+                if (!okToDrop) {
+                    bucket.dropping = false;
+                } else {
+                    bucket.dropNext = controlLaw(bucket.dropNext, bucket.count);
+                }
+            }
+        } else if (okToDrop) {
+            if (!tryMark(packet)) {
+                dropPacket(std::move(packet));
+                codelDrops_++;
+                packet = doDequeue(bucket, now, okToDrop);
+            }
+            bucket.dropping = true;
+
+            // Resume near the previous drop rate if we only just left the
+            // dropping state
+            uint32_t delta = bucket.count - bucket.lastCount;
+            bucket.count = (delta > 1 && now - bucket.dropNext < 16 * interval_) ? delta : 1;
+            bucket.dropNext = controlLaw(now, bucket.count);
+            bucket.lastCount = bucket.count;
+        }
+        return packet;
+    }
+
+    int64_t controlLaw(int64_t t, uint32_t count) const {
+        return t + static_cast<int64_t>(interval_ / std::sqrt(static_cast<double>(count)));
+    }
+
+    PacketSlotPool pool_;
+    std::vector<Bucket> buckets_;
+    FlowList newFlows_;
+    FlowList oldFlows_;
+    uint32_t quantum_;
+    int64_t target_;      // CoDel target sojourn time (ns)
+    int64_t interval_;    // CoDel interval (ns)
+    uint32_t hashSeed_;
+    bool ecnMarking_;
+
+    size_t totalDropped_;
+    size_t codelDrops_;
+    size_t overflowDrops_;
+    size_t ecnMarks_;
+    mutable std::mutex mutex_;
+};
+
+#endif // FQ_CODEL_QUEUE_H
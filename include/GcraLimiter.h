@@ -0,0 +1,36 @@
+#ifndef GCRA_LIMITER_H
+#define GCRA_LIMITER_H
+
+#include "RateLimiter.h"
+#include "TatBucket.h"
+#include <cstdint>
+
+// Generic Cell Rate Algorithm (virtual scheduling) limiter: the same
+// rate-plus-burst contract as TokenBucket, kept as one theoretical arrival
+// time word instead of a token count, a refill timestamp and a mutex. A
+// consume is one load and one compare-and-swap, with no refill arithmetic.
+class GcraLimiter : public RateLimiter {
+public:
+    GcraLimiter(uint64_t rate, uint64_t bucketSize)   // bytes/sec, bytes
+        : bucket_(rate, bucketSize) {}
+
+    bool consumeAt(uint32_t tokens, uint64_t nowNs) override {
+        return bucket_.consumeAt(tokens, nowNs);
+    }
+
+    uint64_t nanosUntilAvailableAt(uint32_t tokens, uint64_t nowNs) override {
+        return bucket_.nanosUntilAt(tokens, nowNs);
+    }
+
+    uint64_t getTokensAt(uint64_t nowNs) override {
+        return bucket_.tokensAt(nowNs);
+    }
+
+    uint64_t getRate() const override { return bucket_.getRate(); }
+    uint64_t getBucketSize() const override { return bucket_.getBurst(); }
+
+private:
+    TatBucket bucket_;
+};
+
+#endif // GCRA_LIMITER_H
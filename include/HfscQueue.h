@@ -0,0 +1,675 @@
+#ifndef HFSC_QUEUE_H
+#define HFSC_QUEUE_H
+
+#include "QueueDiscipline.h"
+#include "PacketSlotPool.h"
+#include "FixedPoint.h"
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+// Hierarchical Fair Service Curve (Stoica, Zhang & Ng, SIGCOMM 1997),
+// following the Linux HFSC scheduler. Each class may have up to three
+// two-piece service curves:
+//  - real-time (leaves only): a guarantee met by deadline, independent of
+//    the hierarchy. A concave curve (m1 > m2) gives a class a delay bound
+//    below what its long-term rate alone would give it.
+//  - link-sharing: how spare capacity is split among siblings, by virtual
+//    time.
+//  - upper limit: a cap on the link-sharing service a class may receive.
+// Packets are sent by the real-time criterion while any leaf is eligible
+// (earliest deadline first), otherwise by link sharing, descending from
+// the root along the smallest virtual time among the children that fit
+// their upper limit.
+//
+// Eligible and not-yet-eligible leaves are kept in two ordered sets (keyed
+// by deadline and eligible time), and each class keeps its active children
+// by virtual time and fit time, so a packet costs O(log classes) per level.
+// Flows are mapped onto leaf classes with assignFlow().
+class HfscQueue final : public QueueDiscipline {
+public:
+    static constexpr uint32_t kRoot = 0;
+    static constexpr uint32_t kNoClass = PacketSlotPool::kNil;
+    static constexpr uint32_t kMtu = 1514;
+
+    // m1 bytes/sec for the first d of a backlog period, m2 bytes/sec after.
+    // Concave when m1 > m2, convex when m1 < m2. A curve with m2 == 0 is
+    // treated as absent.
+    struct ServiceCurve {
+        uint64_t m1;
+        std::chrono::nanoseconds d;
+        uint64_t m2;
+
+        ServiceCurve() : m1(0), d(0), m2(0) {}
+        ServiceCurve(uint64_t m1Rate, std::chrono::nanoseconds duration, uint64_t m2Rate)
+            : m1(m1Rate), d(duration), m2(m2Rate) {}
+
+        static ServiceCurve linear(uint64_t rate) {
+            return ServiceCurve(rate, std::chrono::nanoseconds(0), rate);
+        }
+
+        // tc's "umax dmax rate" form: packets of up to umax bytes within
+        // dmax of their class becoming backlogged, rate in the long run
+        static ServiceCurve fromDelay(uint32_t umax, std::chrono::nanoseconds dmax,
+                                      uint64_t rate) {
+            if (dmax.count() <= 0 || rate == 0) {
+                return linear(rate);
+            }
+            uint64_t burst = static_cast<uint64_t>(umax) * 1000000000ULL /
+                             static_cast<uint64_t>(dmax.count());
+            if (burst > rate) {
+                return ServiceCurve(burst, dmax, rate);
+            }
+            // Slower than the rate anyway: start late instead of slow
+            auto atRate = std::chrono::nanoseconds(
+                static_cast<int64_t>(static_cast<uint64_t>(umax) * 1000000000ULL / rate));
+            return ServiceCurve(0, std::max(dmax - atRate, std::chrono::nanoseconds(0)), rate);
+        }
+
+        bool isSet() const { return m2 > 0; }
+    };
+
+    struct ClassStats {
+        uint64_t packetsSent = 0;
+        uint64_t bytesSent = 0;
+        uint64_t realTimeBytes = 0;   // Sent under the real-time criterion
+        uint32_t queued = 0;
+    };
+
+    // The root has no curves of its own: HFSC is work-conserving apart from
+    // upper limits, and the link rate is whatever drains it (the shaper's
+    // rate limiter here)
+    HfscQueue(size_t maxSize = 1000)
+        : pool_(maxSize)
+        , epoch_(kNoEpoch)
+        , defaultClass_(kNoClass)
+        , totalDropped_(0) {
+        classes_.emplace_back();
+    }
+
+    // Add a class under 'parent'. Real-time curves apply to leaves only and
+    // inner classes need a link-sharing curve; a leaf needs either. Returns
+    // the class id, or kNoClass if the parent has flows or packets of its
+    // own or the curves do not fit its place. Configuration-time only.
+    uint32_t addClass(uint32_t parent, const ServiceCurve& realTime,
+                      const ServiceCurve& linkShare, const ServiceCurve& upperLimit = {}) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (parent >= classes_.size() || (!realTime.isSet() && !linkShare.isSet())) {
+            return kNoClass;
+        }
+        HfscClass& p = classes_[parent];
+        if (p.children == 0 && (p.assignedFlows > 0 || parent == defaultClass_ ||
+                                !p.packets.empty() || p.hasRsc ||
+                                (parent != kRoot && !p.hasFsc))) {
+            return kNoClass;
+        }
+        p.children++;
+
+        uint32_t id = static_cast<uint32_t>(classes_.size());
+        classes_.emplace_back();
+        HfscClass& cl = classes_.back();
+        cl.parent = parent;
+        setCurve(cl.rsc, cl.hasRsc, realTime);
+        setCurve(cl.fsc, cl.hasFsc, linkShare);
+        setCurve(cl.usc, cl.hasUsc, upperLimit);
+        rtscInit(cl.deadline, cl.rsc, 0, 0);
+        rtscInit(cl.eligible, cl.rsc, 0, 0);
+        rtscInit(cl.virtualCurve, cl.fsc, 0, 0);
+        rtscInit(cl.ulimit, cl.usc, 0, 0);
+        return id;
+    }
+
+    // Send a flow's packets to a leaf class
+    bool assignFlow(uint32_t flowId, uint32_t classId) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (classId == kRoot || classId >= classes_.size() || classes_[classId].children > 0) {
+            return false;
+        }
+        auto it = flowClass_.find(flowId);
+        if (it != flowClass_.end()) {
+            classes_[it->second].assignedFlows--;
+        }
+        flowClass_[flowId] = classId;
+        classes_[classId].assignedFlows++;
+        return true;
+    }
+
+    // Leaf class for flows without an explicit assignment (otherwise dropped)
+    bool setDefaultClass(uint32_t classId) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (classId == kRoot || classId >= classes_.size() || classes_[classId].children > 0) {
+            return false;
+        }
+        defaultClass_ = classId;
+        return true;
+    }
+
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        auto now = std::chrono::high_resolution_clock::now();
+        packet->setEnqueueTime(now);
+        return enqueueAt(std::move(packet), toNanos(now));
+    }
+
+    // nullptr if nothing is queued, or no leaf is eligible and every
+    // backlogged class is held back by an upper limit
+    std::shared_ptr<Packet> tryDequeue() override {
+        return tryDequeueAt(nowNanos());
+    }
+
+    // enqueue/tryDequeue on a caller-supplied timeline (ns), for simulation
+    bool enqueueAt(std::shared_ptr<Packet> packet, int64_t nowNs) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        uint32_t id = classify(packet->getFlowId());
+        if (id == kNoClass || pool_.full()) {
+            totalDropped_++;
+            return false;
+        }
+
+        uint32_t size = packet->getSize();
+        HfscClass& cl = classes_[id];
+        bool activates = cl.packets.empty();
+        pool_.push(cl.packets, std::move(packet));
+        telemetry_.recordEnqueue(pool_.used(), nowNs);
+
+        if (activates) {
+            uint64_t now = curveTime(nowNs);
+            if (cl.hasRsc) {
+                initEd(id, size, now);
+            }
+            if (cl.hasFsc) {
+                initVf(id, now);
+            }
+        }
+        return true;
+    }
+
+    std::shared_ptr<Packet> tryDequeueAt(int64_t nowNs) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto packet = dequeueLocked(curveTime(nowNs));
+        if (packet) {
+            telemetry_.recordDequeue(pool_.used(), nowNs,
+                                     nowNs - toNanos(packet->getEnqueueTime()));
+        } else {
+            telemetry_.recordOccupancy(pool_.used(), nowNs);
+        }
+        return packet;
+    }
+
+    // Now if a packet can go, else the earlier of the next eligible time and
+    // the time the first upper-limited class fits again
+    int64_t nextEligibleTime() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pool_.used() == 0) {
+            return kNeverEligible;
+        }
+        uint64_t next = kInfinity;
+        if (!ready_.empty()) {
+            return nowNanos();
+        }
+        if (!pending_.empty()) {
+            next = pending_.begin()->first;
+        }
+        const HfscClass& root = classes_[kRoot];
+        if (!root.vtTree.empty()) {
+            next = std::min(next, root.cfmin);
+        }
+        if (next == kInfinity) {
+            return nowNanos();
+        }
+        return std::max(epoch_ + static_cast<int64_t>(next), nowNanos());
+    }
+
+    size_t size() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used();
+    }
+
+    bool empty() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used() == 0;
+    }
+
+    size_t getTotalDropped() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return totalDropped_;
+    }
+
+    ClassStats getClassStats(uint32_t classId) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ClassStats stats;
+        if (classId < classes_.size()) {
+            const HfscClass& cl = classes_[classId];
+            stats.packetsSent = cl.packetsSent;
+            stats.bytesSent = cl.total;
+            stats.realTimeBytes = cl.cumul;
+            stats.queued = cl.packets.packets;
+        }
+        return stats;
+    }
+
+    size_t getNumClasses() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return classes_.size();
+    }
+
+private:
+    static constexpr unsigned kSmShift = 32;     // Fraction bits of bytes/ns slopes
+    static constexpr unsigned kIsmShift = 20;    // Fraction bits of ns/byte slopes
+    static constexpr uint64_t kInfinity = UINT64_MAX;
+    static constexpr int64_t kNoEpoch = INT64_MIN;
+
+    enum class RtState : uint8_t { NONE, PENDING, READY };
+
+    // Service curve in internal units: slopes in bytes/ns (sm) and ns/byte
+    // (ism), first segment dx ns long and dy bytes high
+    struct InternalCurve {
+        uint64_t sm1 = 0, ism1 = kInfinity;
+        uint64_t dx = 0, dy = 0;
+        uint64_t sm2 = 0, ism2 = kInfinity;
+    };
+
+    // An internal curve anchored at (x ns, y bytes)
+    struct RuntimeCurve {
+        uint64_t x = 0, y = 0;
+        InternalCurve sc;
+    };
+
+    struct HfscClass {
+        uint32_t parent = kNoClass;
+        uint32_t children = 0;
+        uint32_t assignedFlows = 0;
+        bool hasRsc = false, hasFsc = false, hasUsc = false;
+        InternalCurve rsc, fsc, usc;
+
+        // Real-time state: bytes served by it, eligible time and deadline
+        RuntimeCurve deadline, eligible;
+        uint64_t cumul = 0;
+        uint64_t e = 0, d = 0;
+        RtState rtState = RtState::NONE;
+        uint64_t rtKey = 0;          // e or d, whichever set the class is in
+
+        // Link-sharing state
+        RuntimeCurve virtualCurve, ulimit;
+        uint64_t total = 0;          // Bytes sent by this class and below
+        uint64_t vt = 0, vtKey = 0, vtadj = 0;
+        uint64_t cvtmin = 0;         // Smallest vt of children served this period
+        uint64_t cvtoff = 0;         // Largest vt of children when they went idle
+        uint32_t vtperiod = 0, parentperiod = 0, nactive = 0;
+        uint64_t myf = 0;            // Fit time under the upper limit
+        uint64_t cfmin = 0;          // Smallest fit time among active children
+        uint64_t f = 0;              // max(myf, cfmin)
+        std::set<std::pair<uint64_t, uint32_t>> vtTree;  // Active children by vt
+        std::set<std::pair<uint64_t, uint32_t>> cfTree;  // Active children by f
+
+        PacketSlotPool::List packets;
+        uint64_t packetsSent = 0;
+    };
+
+    // Curve times count from the first packet, so they stay small
+    uint64_t curveTime(int64_t nanos) {
+        if (epoch_ == kNoEpoch) {
+            epoch_ = nanos;
+        }
+        return nanos > epoch_ ? static_cast<uint64_t>(nanos - epoch_) : 0;
+    }
+
+    static uint64_t addSat(uint64_t a, uint64_t b) {
+        return b > kInfinity - a ? kInfinity : a + b;
+    }
+
+    static uint64_t segX2Y(uint64_t x, uint64_t sm) {
+        return FixedPoint::mulShr(x, sm, kSmShift);
+    }
+
+    static uint64_t segY2X(uint64_t y, uint64_t ism) {
+        if (y == 0) return 0;
+        if (ism == kInfinity) return kInfinity;
+        return FixedPoint::mulShr(y, ism, kIsmShift);
+    }
+
+    static void setCurve(InternalCurve& isc, bool& has, const ServiceCurve& sc) {
+        has = sc.isSet();
+        if (!has) {
+            return;
+        }
+        auto toSm = [](uint64_t m) {
+            return FixedPoint::scaledRatio(m, 1000000000ULL, kSmShift);
+        };
+        auto toIsm = [](uint64_t m) {
+            return m == 0 ? kInfinity : FixedPoint::scaledRatio(1000000000ULL, m, kIsmShift);
+        };
+        isc.sm1 = toSm(sc.m1);
+        isc.ism1 = toIsm(sc.m1);
+        isc.dx = static_cast<uint64_t>(std::max<int64_t>(sc.d.count(), 0));
+        isc.dy = segX2Y(isc.dx, isc.sm1);
+        isc.sm2 = toSm(sc.m2);
+        isc.ism2 = toIsm(sc.m2);
+    }
+
+    static void rtscInit(RuntimeCurve& rtsc, const InternalCurve& isc, uint64_t x, uint64_t y) {
+        rtsc.x = x;
+        rtsc.y = y;
+        rtsc.sc = isc;
+    }
+
+    // Time at which the curve reaches y bytes
+    static uint64_t rtscY2X(const RuntimeCurve& rtsc, uint64_t y) {
+        if (y < rtsc.y) {
+            return rtsc.x;
+        }
+        if (y <= rtsc.y + rtsc.sc.dy) {
+            return rtsc.sc.dy == 0 ? rtsc.x + rtsc.sc.dx
+                                   : addSat(rtsc.x, segY2X(y - rtsc.y, rtsc.sc.ism1));
+        }
+        return addSat(rtsc.x + rtsc.sc.dx, segY2X(y - rtsc.y - rtsc.sc.dy, rtsc.sc.ism2));
+    }
+
+    // Bytes of the curve at time x
+    static uint64_t rtscX2Y(const RuntimeCurve& rtsc, uint64_t x) {
+        if (x <= rtsc.x) {
+            return rtsc.y;
+        }
+        if (x <= rtsc.x + rtsc.sc.dx) {
+            return rtsc.y + segX2Y(x - rtsc.x, rtsc.sc.sm1);
+        }
+        return rtsc.y + rtsc.sc.dy + segX2Y(x - rtsc.x - rtsc.sc.dx, rtsc.sc.sm2);
+    }
+
+    // Replace the runtime curve by the minimum of itself and the service
+    // curve anchored at (x, y), as a new backlog period starts
+    static void rtscMin(RuntimeCurve& rtsc, const InternalCurve& isc, uint64_t x, uint64_t y) {
+        if (isc.sm1 <= isc.sm2) {
+            // Convex: the new curve is below from its start on, if at all
+            if (rtscX2Y(rtsc, x) < y) {
+                return;
+            }
+            rtsc.x = x;
+            rtsc.y = y;
+            return;
+        }
+
+        // Concave
+        uint64_t y1 = rtscX2Y(rtsc, x);
+        if (y1 <= y) {
+            return;
+        }
+        uint64_t y2 = rtscX2Y(rtsc, x + isc.dx);
+        if (y2 >= y + isc.dy) {
+            rtsc.x = x;
+            rtsc.y = y;
+            rtsc.sc.dx = isc.dx;
+            rtsc.sc.dy = isc.dy;
+            return;
+        }
+        // The curves cross: the new curve's first segment runs until it
+        // meets the old curve's second one
+        uint64_t dx = FixedPoint::scaledRatio(y1 - y, isc.sm1 - isc.sm2, kSmShift);
+        if (rtsc.x + rtsc.sc.dx > x) {
+            dx += rtsc.x + rtsc.sc.dx - x;
+        }
+        rtsc.x = x;
+        rtsc.y = y;
+        rtsc.sc.dx = dx;
+        rtsc.sc.dy = segX2Y(dx, isc.sm1);
+    }
+
+    uint32_t classify(uint32_t flowId) const {
+        auto it = flowClass_.find(flowId);
+        if (it != flowClass_.end()) {
+            return it->second;
+        }
+        return defaultClass_;
+    }
+
+    std::shared_ptr<Packet> dequeueLocked(uint64_t now) {
+        // Real-time criterion: earliest deadline among eligible leaves
+        while (!pending_.empty() && pending_.begin()->first <= now) {
+            uint32_t id = pending_.begin()->second;
+            pending_.erase(pending_.begin());
+            rtInsertReady(id);
+        }
+        bool realTime = !ready_.empty();
+        uint32_t id = realTime ? ready_.begin()->second : minVirtualTimeLeaf(now);
+        if (id == kNoClass) {
+            return nullptr;
+        }
+
+        HfscClass& cl = classes_[id];
+        auto packet = pool_.pop(cl.packets);
+        uint32_t size = packet->getSize();
+        cl.packetsSent++;
+
+        updateVf(id, size);
+        if (realTime) {
+            cl.cumul += size;
+        }
+        if (cl.hasRsc) {
+            if (!cl.packets.empty()) {
+                uint32_t nextLen = pool_.front(cl.packets)->getSize();
+                if (realTime) {
+                    updateEd(id, nextLen);
+                } else {
+                    updateD(id, nextLen);
+                }
+            } else {
+                rtRemove(id);
+            }
+        }
+        return packet;
+    }
+
+    // Link-sharing criterion: from the root down, the child with the
+    // smallest virtual time among those within their upper limit
+    uint32_t minVirtualTimeLeaf(uint64_t now) {
+        uint32_t id = kRoot;
+        if (classes_[id].cfmin > now) {
+            return kNoClass;
+        }
+        while (classes_[id].children > 0) {
+            uint32_t next = kNoClass;
+            for (const auto& entry : classes_[id].vtTree) {
+                if (classes_[entry.second].f <= now) {
+                    next = entry.second;
+                    break;
+                }
+            }
+            if (next == kNoClass) {
+                return kNoClass;
+            }
+            HfscClass& p = classes_[id];
+            p.cvtmin = std::max(p.cvtmin, classes_[next].vt);
+            id = next;
+        }
+        return id;
+    }
+
+    void initEd(uint32_t id, uint32_t nextLen, uint64_t now) {
+        HfscClass& cl = classes_[id];
+        rtscMin(cl.deadline, cl.rsc, now, cl.cumul);
+        // As in Linux, a concave curve's eligible curve is its deadline
+        // curve. A convex curve's is the linear part alone, since its slow
+        // first segment would otherwise make the class eligible late.
+        cl.eligible = cl.deadline;
+        if (cl.rsc.sm1 <= cl.rsc.sm2) {
+            cl.eligible.sc.dx = 0;
+            cl.eligible.sc.dy = 0;
+        }
+        cl.e = rtscY2X(cl.eligible, cl.cumul);
+        cl.d = rtscY2X(cl.deadline, cl.cumul + nextLen);
+        rtInsertPending(id);
+    }
+
+    void updateEd(uint32_t id, uint32_t nextLen) {
+        HfscClass& cl = classes_[id];
+        cl.e = rtscY2X(cl.eligible, cl.cumul);
+        cl.d = rtscY2X(cl.deadline, cl.cumul + nextLen);
+        rtRemove(id);
+        rtInsertPending(id);
+    }
+
+    void updateD(uint32_t id, uint32_t nextLen) {
+        HfscClass& cl = classes_[id];
+        cl.d = rtscY2X(cl.deadline, cl.cumul + nextLen);
+        if (cl.rtState == RtState::READY) {
+            rtRemove(id);
+            rtInsertReady(id);
+        }
+    }
+
+    void rtInsertPending(uint32_t id) {
+        HfscClass& cl = classes_[id];
+        cl.rtState = RtState::PENDING;
+        cl.rtKey = cl.e;
+        pending_.emplace(cl.e, id);
+    }
+
+    void rtInsertReady(uint32_t id) {
+        HfscClass& cl = classes_[id];
+        cl.rtState = RtState::READY;
+        cl.rtKey = cl.d;
+        ready_.emplace(cl.d, id);
+    }
+
+    void rtRemove(uint32_t id) {
+        HfscClass& cl = classes_[id];
+        if (cl.rtState == RtState::PENDING) {
+            pending_.erase(std::make_pair(cl.rtKey, id));
+        } else if (cl.rtState == RtState::READY) {
+            ready_.erase(std::make_pair(cl.rtKey, id));
+        }
+        cl.rtState = RtState::NONE;
+    }
+
+    // A leaf became backlogged: activate it and any ancestors that were idle
+    // for link sharing
+    void initVf(uint32_t id, uint64_t now) {
+        bool goActive = true;
+        for (; classes_[id].parent != kNoClass; id = classes_[id].parent) {
+            HfscClass& cl = classes_[id];
+            HfscClass& p = classes_[cl.parent];
+            goActive = goActive && cl.nactive++ == 0;
+
+            if (goActive) {
+                if (!p.vtTree.empty()) {
+                    // Start between the smallest and largest sibling, and
+                    // never below where this class was in the same parent
+                    // backlog period
+                    uint64_t vt = classes_[p.vtTree.rbegin()->second].vt;
+                    if (p.cvtmin != 0) {
+                        vt = (p.cvtmin + vt) / 2;
+                    }
+                    if (p.vtperiod != cl.parentperiod || vt > cl.vt) {
+                        cl.vt = vt;
+                    }
+                } else {
+                    // First child of a new parent backlog period
+                    cl.vt = p.cvtoff;
+                    p.cvtmin = 0;
+                }
+
+                rtscMin(cl.virtualCurve, cl.fsc, cl.vt, cl.total);
+                cl.vtadj = 0;
+                cl.vtperiod++;
+                cl.parentperiod = p.vtperiod;
+                if (p.nactive == 0) {
+                    cl.parentperiod++;
+                }
+                cl.f = 0;
+                cl.vtKey = cl.vt;
+                p.vtTree.emplace(cl.vt, id);
+                p.cfTree.emplace(cl.f, id);
+
+                if (cl.hasUsc) {
+                    rtscMin(cl.ulimit, cl.usc, now, cl.total);
+                    cl.myf = rtscY2X(cl.ulimit, cl.total);
+                }
+            }
+
+            setFitTime(id, std::max(cl.myf, cl.cfmin));
+            updateCfmin(cl.parent);
+        }
+    }
+
+    // Charge a sent packet up the tree, advancing virtual and fit times and
+    // deactivating classes left without backlog
+    void updateVf(uint32_t id, uint32_t len) {
+        bool goPassive = classes_[id].packets.empty() && classes_[id].hasFsc;
+
+        for (; classes_[id].parent != kNoClass; id = classes_[id].parent) {
+            HfscClass& cl = classes_[id];
+            cl.total += len;
+
+            if (!cl.hasFsc || cl.nactive == 0) {
+                continue;
+            }
+            HfscClass& p = classes_[cl.parent];
+            goPassive = goPassive && --cl.nactive == 0;
+
+            cl.vt = rtscY2X(cl.virtualCurve, cl.total) + cl.vtadj;
+            // Below cvtmin means the class was skipped by an upper limit
+            // earlier; catch up rather than claim that service now
+            if (cl.vt < p.cvtmin) {
+                cl.vtadj += p.cvtmin - cl.vt;
+                cl.vt = p.cvtmin;
+            }
+
+            if (goPassive) {
+                p.cvtoff = std::max(p.cvtoff, cl.vt);
+                p.vtTree.erase(std::make_pair(cl.vtKey, id));
+                p.cfTree.erase(std::make_pair(cl.f, id));
+                updateCfmin(cl.parent);
+                continue;
+            }
+
+            p.vtTree.erase(std::make_pair(cl.vtKey, id));
+            cl.vtKey = cl.vt;
+            p.vtTree.emplace(cl.vt, id);
+
+            if (cl.hasUsc) {
+                cl.myf = rtscY2X(cl.ulimit, cl.total);
+            }
+            uint64_t f = std::max(cl.myf, cl.cfmin);
+            if (f != cl.f) {
+                setFitTime(id, f);
+                updateCfmin(cl.parent);
+            }
+        }
+    }
+
+    void setFitTime(uint32_t id, uint64_t f) {
+        HfscClass& cl = classes_[id];
+        if (f == cl.f) {
+            return;
+        }
+        HfscClass& p = classes_[cl.parent];
+        p.cfTree.erase(std::make_pair(cl.f, id));
+        cl.f = f;
+        p.cfTree.emplace(cl.f, id);
+    }
+
+    void updateCfmin(uint32_t id) {
+        HfscClass& cl = classes_[id];
+        cl.cfmin = cl.cfTree.empty() ? 0 : cl.cfTree.begin()->first;
+    }
+
+    PacketSlotPool pool_;
+    std::vector<HfscClass> classes_;
+    std::unordered_map<uint32_t, uint32_t> flowClass_;
+    int64_t epoch_;             // Time of the first packet (ns)
+    uint32_t defaultClass_;
+
+    std::set<std::pair<uint64_t, uint32_t>> pending_;  // Real-time leaves by e
+    std::set<std::pair<uint64_t, uint32_t>> ready_;    // Eligible leaves by d
+
+    size_t totalDropped_;
+    mutable std::mutex mutex_;
+};
+
+#endif // HFSC_QUEUE_H
@@ -0,0 +1,556 @@
+#ifndef HTB_QUEUE_H
+#define HTB_QUEUE_H
+
+#include "QueueDiscipline.h"
+#include "PacketSlotPool.h"
+#include "FixedPoint.h"
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+
+// Hierarchical Token Bucket, following the Linux HTB scheduler. Classes form
+// a tree under a root sized to the link; each class has an assured rate and
+// a ceil, both kept as token buckets measured in nanoseconds of credit.
+// A class below its rate sends on its own (CAN_SEND), one between rate and
+// ceil borrows spare credit from its ancestors (MAY_BORROW), and one above
+// ceil waits (CANT_SEND).
+//
+// Active classes are hooked into per-level, per-priority round-robin rings:
+// a sending class into the row of its own level, a borrowing class into its
+// parent's feed for that priority. Dequeue serves the lowest level first,
+// lowest priority number within a level, and walks feeds down to a leaf, so
+// it costs O(depth) plus O(log classes) for each class that changes mode.
+// Flows are mapped onto leaf classes with assignFlow().
+class HtbQueue final : public QueueDiscipline {
+public:
+    static constexpr uint32_t kRoot = 0;
+    static constexpr uint32_t kNoClass = PacketSlotPool::kNil;
+    static constexpr unsigned kNumPrios = 8;    // 0 is served first
+    static constexpr unsigned kMaxDepth = 8;    // Levels, leaves are level 0
+    static constexpr uint32_t kMtu = 1514;
+
+    enum class Mode : uint8_t { CAN_SEND, MAY_BORROW, CANT_SEND };
+
+    struct ClassStats {
+        uint64_t packetsSent = 0;
+        uint64_t bytesSent = 0;
+        uint64_t lends = 0;     // Packets sent from this class's own rate
+        uint64_t borrows = 0;   // Packets this class sent on ancestors' credit
+        uint32_t queued = 0;
+        Mode mode = Mode::CAN_SEND;
+    };
+
+    // rate is the link rate in bytes/sec; the root's rate and ceil
+    HtbQueue(uint64_t rate, size_t maxSize = 1000, uint64_t burst = 0)
+        : pool_(maxSize)
+        , defaultClass_(kNoClass)
+        , rowMask_()
+        , totalDropped_(0) {
+        classes_.emplace_back();
+        initClass(classes_.back(), kNoClass, rate, rate, 0, burst, burst, 0, nowNanos());
+    }
+
+    // Add a class under 'parent' (rate and ceil in bytes/sec, burst sizes in
+    // bytes, 0 for defaults). Returns its id, or kNoClass if the parent has
+    // flows or packets of its own or the tree would exceed kMaxDepth.
+    // Configuration-time only: call before traffic starts.
+    uint32_t addClass(uint32_t parent, uint64_t rate, uint64_t ceil, unsigned prio = 0,
+                      uint64_t burst = 0, uint64_t cburst = 0, uint32_t quantum = 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (parent >= classes_.size()) {
+            return kNoClass;
+        }
+        HtbClass& p = classes_[parent];
+        if (p.children == 0) {
+            if (p.assignedFlows > 0 || parent == defaultClass_ || !p.packets.empty()) {
+                return kNoClass;
+            }
+            int level = p.parent == kNoClass ? static_cast<int>(kMaxDepth) - 1
+                                             : classes_[p.parent].level - 1;
+            if (level < 1) {
+                return kNoClass;
+            }
+            p.level = level;
+        }
+        p.children++;
+
+        uint32_t id = static_cast<uint32_t>(classes_.size());
+        classes_.emplace_back();
+        initClass(classes_.back(), parent, rate, ceil, std::min(prio, kNumPrios - 1),
+                  burst, cburst, quantum, nowNanos());
+        return id;
+    }
+
+    // Send a flow's packets to a leaf class
+    bool assignFlow(uint32_t flowId, uint32_t classId) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (classId >= classes_.size() || classes_[classId].children > 0) {
+            return false;
+        }
+        auto it = flowClass_.find(flowId);
+        if (it != flowClass_.end()) {
+            classes_[it->second].assignedFlows--;
+        }
+        flowClass_[flowId] = classId;
+        classes_[classId].assignedFlows++;
+        return true;
+    }
+
+    // Leaf class for flows without an explicit assignment (otherwise dropped)
+    bool setDefaultClass(uint32_t classId) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (classId >= classes_.size() || classes_[classId].children > 0) {
+            return false;
+        }
+        defaultClass_ = classId;
+        return true;
+    }
+
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        uint32_t id = classify(packet->getFlowId());
+        if (id == kNoClass || pool_.full()) {
+            totalDropped_++;
+            return false;
+        }
+
+        auto now = std::chrono::high_resolution_clock::now();
+        packet->setEnqueueTime(now);
+
+        HtbClass& cl = classes_[id];
+        pool_.push(cl.packets, std::move(packet));
+        telemetry_.recordEnqueue(pool_.used(), toNanos(now));
+
+        if (cl.activePrios == 0) {
+            cl.activePrios = static_cast<uint8_t>(1u << cl.prio);
+            activatePrios(id);
+        }
+        return true;
+    }
+
+    // nullptr if nothing is queued or every backlogged class is over its ceil
+    std::shared_ptr<Packet> tryDequeue() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = nowNanos();
+
+        auto packet = dequeueLocked(now);
+        if (packet) {
+            telemetry_.recordDequeue(pool_.used(), now,
+                                     now - toNanos(packet->getEnqueueTime()));
+        } else {
+            telemetry_.recordOccupancy(pool_.used(), now);
+        }
+        return packet;
+    }
+
+    // Now if a class can send, else when the first waiting class changes
+    // mode (which may release a packet)
+    int64_t nextEligibleTime() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pool_.used() == 0) {
+            return kNeverEligible;
+        }
+        for (uint8_t mask : rowMask_) {
+            if (mask != 0) {
+                return nowNanos();
+            }
+        }
+        return waiting_.empty() ? nowNanos() : waiting_.begin()->first;
+    }
+
+    size_t size() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used();
+    }
+
+    bool empty() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used() == 0;
+    }
+
+    size_t getTotalDropped() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return totalDropped_;
+    }
+
+    ClassStats getClassStats(uint32_t classId) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ClassStats stats;
+        if (classId < classes_.size()) {
+            const HtbClass& cl = classes_[classId];
+            stats.packetsSent = cl.packetsSent;
+            stats.bytesSent = cl.bytesSent;
+            stats.lends = cl.lends;
+            stats.borrows = cl.borrows;
+            stats.queued = cl.packets.packets;
+            stats.mode = cl.mode;
+        }
+        return stats;
+    }
+
+    size_t getNumClasses() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return classes_.size();
+    }
+
+private:
+    static constexpr int64_t kMaxBuffer = 60LL * 1000000000LL;  // Cap on idle credit
+    static constexpr unsigned kCostShift = 32;
+    static constexpr int64_t kNotWaiting = -1;
+
+    // Round-robin ring of class ids, linked through HtbClass::next/prev for
+    // one priority. head is the class to serve next.
+    struct Ring {
+        uint32_t head = kNoClass;
+
+        bool empty() const { return head == kNoClass; }
+    };
+
+    struct HtbClass {
+        uint32_t parent = kNoClass;
+        uint32_t children = 0;
+        int level = 0;
+        unsigned prio = 0;
+        uint32_t quantum = 0;
+
+        // Token state, in nanoseconds of transmission time
+        uint64_t rateCost = 0;      // ns per byte at rate, scaled by 2^kCostShift
+        uint64_t ceilCost = 0;      // ns per byte at ceil, scaled by 2^kCostShift
+        int64_t buffer = 0;
+        int64_t cbuffer = 0;
+        int64_t tokens = 0;
+        int64_t ctokens = 0;
+        int64_t checkpoint = 0;     // Time tokens were last brought up to date
+        int64_t waitKey = kNotWaiting;
+        Mode mode = Mode::CAN_SEND;
+
+        uint8_t activePrios = 0;    // Priorities this class is active for
+        PacketSlotPool::List packets;
+        int64_t deficit[kMaxDepth] = {};
+        Ring feed[kNumPrios];       // Borrowing children, per priority
+        uint32_t next[kNumPrios] = {};
+        uint32_t prev[kNumPrios] = {};
+
+        uint32_t assignedFlows = 0;
+        uint64_t packetsSent = 0;
+        uint64_t bytesSent = 0;
+        uint64_t lends = 0;
+        uint64_t borrows = 0;
+    };
+
+    static int64_t burstNanos(uint64_t burst, uint64_t cost) {
+        return static_cast<int64_t>(std::min<uint64_t>(
+            FixedPoint::mulShr(burst, cost, kCostShift), kMaxBuffer));
+    }
+
+    static void initClass(HtbClass& cl, uint32_t parent, uint64_t rate, uint64_t ceil,
+                          unsigned prio, uint64_t burst, uint64_t cburst,
+                          uint32_t quantum, int64_t now) {
+        rate = std::max<uint64_t>(rate, 1);
+        ceil = std::max(ceil, rate);
+
+        cl.parent = parent;
+        cl.prio = prio;
+        // Linux defaults: quantum rate/10 clamped to [1000, 200000] bytes,
+        // burst enough for 10 ms at the rate but at least one MTU
+        cl.quantum = quantum > 0 ? quantum
+                                 : static_cast<uint32_t>(std::min<uint64_t>(
+                                       std::max<uint64_t>(rate / 10, 1000), 200000));
+        cl.rateCost = FixedPoint::scaledRatio(1000000000ULL, rate, kCostShift);
+        cl.ceilCost = FixedPoint::scaledRatio(1000000000ULL, ceil, kCostShift);
+        cl.buffer = burstNanos(burst > 0 ? burst : std::max<uint64_t>(rate / 100, kMtu),
+                               cl.rateCost);
+        cl.cbuffer = burstNanos(cburst > 0 ? cburst : std::max<uint64_t>(ceil / 100, kMtu),
+                                cl.ceilCost);
+        cl.tokens = cl.buffer;
+        cl.ctokens = cl.cbuffer;
+        cl.checkpoint = now;
+    }
+
+    uint32_t classify(uint32_t flowId) const {
+        auto it = flowClass_.find(flowId);
+        if (it != flowClass_.end()) {
+            return it->second;
+        }
+        if (defaultClass_ != kNoClass) {
+            return defaultClass_;
+        }
+        return classes_.size() == 1 ? kRoot : kNoClass;
+    }
+
+    std::shared_ptr<Packet> dequeueLocked(int64_t now) {
+        processEvents(now);
+
+        for (unsigned level = 0; level < kMaxDepth; level++) {
+            uint8_t mask = rowMask_[level];
+            if (mask != 0) {
+                return dequeueTree(lowestPrio(mask), level, now);
+            }
+        }
+        return nullptr;
+    }
+
+    static unsigned lowestPrio(uint8_t mask) {
+        unsigned prio = 0;
+        while (!(mask & (1u << prio))) {
+            prio++;
+        }
+        return prio;
+    }
+
+    // Serve the leaf reached from row[level][prio] through the feeds
+    std::shared_ptr<Packet> dequeueTree(unsigned prio, unsigned level, int64_t now) {
+        uint32_t id = rows_[level][prio].head;
+        while (classes_[id].children > 0) {
+            id = classes_[id].feed[prio].head;
+        }
+
+        HtbClass& cl = classes_[id];
+        auto packet = pool_.pop(cl.packets);
+        uint32_t size = packet->getSize();
+
+        cl.deficit[level] -= size;
+        if (cl.deficit[level] < 0) {
+            cl.deficit[level] += cl.quantum;
+            Ring& ring = level > 0 ? classes_[cl.parent].feed[prio] : rows_[0][prio];
+            ring.head = cl.next[prio];
+        }
+
+        if (cl.packets.empty()) {
+            deactivatePrios(id);
+            cl.activePrios = 0;
+        }
+        cl.packetsSent++;
+        cl.bytesSent += size;
+        charge(id, level, size, now);
+        return packet;
+    }
+
+    // Charge a sent packet to the leaf and all its ancestors. Classes at or
+    // above the level it was served from pay from their rate bucket; those
+    // below borrowed, so only their ceil bucket is charged.
+    void charge(uint32_t id, unsigned level, uint32_t bytes, int64_t now) {
+        while (id != kNoClass) {
+            HtbClass& cl = classes_[id];
+            int64_t diff = std::min(now - cl.checkpoint, kMaxBuffer);
+
+            if (cl.level >= static_cast<int>(level)) {
+                if (cl.level == static_cast<int>(level)) {
+                    cl.lends++;
+                }
+                cl.tokens = accountTokens(cl.tokens, cl.buffer, diff, bytes, cl.rateCost);
+            } else {
+                cl.borrows++;
+                cl.tokens += diff;
+            }
+            cl.ctokens = accountTokens(cl.ctokens, cl.cbuffer, diff, bytes, cl.ceilCost);
+            cl.checkpoint = now;
+
+            Mode oldMode = cl.mode;
+            diff = 0;
+            changeMode(id, diff);
+            if (oldMode != cl.mode) {
+                if (oldMode != Mode::CAN_SEND) {
+                    removeFromWait(id);
+                }
+                if (cl.mode != Mode::CAN_SEND) {
+                    addToWait(id, now + diff);
+                }
+            }
+            id = cl.parent;
+        }
+    }
+
+    static int64_t accountTokens(int64_t tokens, int64_t buffer, int64_t diff,
+                                 uint32_t bytes, uint64_t cost) {
+        int64_t toks = std::min(tokens + diff, buffer);
+        toks -= static_cast<int64_t>(FixedPoint::mulShr(bytes, cost, kCostShift));
+        return toks <= -kMaxBuffer ? 1 - kMaxBuffer : toks;
+    }
+
+    // Mode the class would be in after 'diff' more nanoseconds of credit.
+    // When not CAN_SEND, diff is set to the time until the mode improves.
+    static Mode classMode(const HtbClass& cl, int64_t& diff) {
+        int64_t toks = cl.ctokens + diff;
+        if (toks < 0) {
+            diff = -toks;
+            return Mode::CANT_SEND;
+        }
+        toks = cl.tokens + diff;
+        if (toks >= 0) {
+            return Mode::CAN_SEND;
+        }
+        diff = -toks;
+        return Mode::MAY_BORROW;
+    }
+
+    void changeMode(uint32_t id, int64_t& diff) {
+        HtbClass& cl = classes_[id];
+        Mode mode = classMode(cl, diff);
+        if (mode == cl.mode) {
+            return;
+        }
+        if (cl.activePrios != 0) {
+            if (cl.mode != Mode::CANT_SEND) {
+                deactivatePrios(id);
+            }
+            cl.mode = mode;
+            if (mode != Mode::CANT_SEND) {
+                activatePrios(id);
+            }
+        } else {
+            cl.mode = mode;
+        }
+    }
+
+    // Re-evaluate classes whose wait time has passed
+    void processEvents(int64_t now) {
+        while (!waiting_.empty() && waiting_.begin()->first <= now) {
+            uint32_t id = waiting_.begin()->second;
+            waiting_.erase(waiting_.begin());
+
+            HtbClass& cl = classes_[id];
+            cl.waitKey = kNotWaiting;
+            int64_t diff = std::min(now - cl.checkpoint, kMaxBuffer);
+            changeMode(id, diff);
+            if (cl.mode != Mode::CAN_SEND) {
+                addToWait(id, now + diff);
+            }
+        }
+    }
+
+    void addToWait(uint32_t id, int64_t when) {
+        classes_[id].waitKey = when;
+        waiting_.emplace(when, id);
+    }
+
+    void removeFromWait(uint32_t id) {
+        HtbClass& cl = classes_[id];
+        if (cl.waitKey != kNotWaiting) {
+            waiting_.erase(std::make_pair(cl.waitKey, id));
+            cl.waitKey = kNotWaiting;
+        }
+    }
+
+    // Hook a class in for the priorities in its activePrios: into its
+    // parent's feeds while it borrows (activating the parent in turn for
+    // priorities the parent was not yet active for), into its level's row
+    // once an ancestor that can send is reached
+    void activatePrios(uint32_t id) {
+        uint8_t mask = classes_[id].activePrios;
+        uint32_t parent = classes_[id].parent;
+
+        while (classes_[id].mode == Mode::MAY_BORROW && parent != kNoClass && mask) {
+            HtbClass& p = classes_[parent];
+            for (unsigned prio = 0; prio < kNumPrios; prio++) {
+                uint8_t bit = static_cast<uint8_t>(1u << prio);
+                if (!(mask & bit)) continue;
+                if (!p.feed[prio].empty()) {
+                    mask &= static_cast<uint8_t>(~bit);  // Parent already active
+                }
+                ringInsert(p.feed[prio], id, prio);
+            }
+            p.activePrios |= mask;
+            id = parent;
+            parent = p.parent;
+        }
+        if (classes_[id].mode == Mode::CAN_SEND && mask) {
+            addToRow(id, mask);
+        }
+    }
+
+    // Inverse of activatePrios
+    void deactivatePrios(uint32_t id) {
+        uint8_t mask = classes_[id].activePrios;
+        uint32_t parent = classes_[id].parent;
+
+        while (classes_[id].mode == Mode::MAY_BORROW && parent != kNoClass && mask) {
+            HtbClass& p = classes_[parent];
+            uint8_t emptied = 0;
+            for (unsigned prio = 0; prio < kNumPrios; prio++) {
+                uint8_t bit = static_cast<uint8_t>(1u << prio);
+                if (!(mask & bit)) continue;
+                ringRemove(p.feed[prio], id, prio);
+                if (p.feed[prio].empty()) {
+                    emptied |= bit;
+                }
+            }
+            p.activePrios &= static_cast<uint8_t>(~emptied);
+            id = parent;
+            parent = p.parent;
+            mask = emptied;
+        }
+        if (classes_[id].mode == Mode::CAN_SEND && mask) {
+            removeFromRow(id, mask);
+        }
+    }
+
+    void addToRow(uint32_t id, uint8_t mask) {
+        unsigned level = static_cast<unsigned>(classes_[id].level);
+        for (unsigned prio = 0; prio < kNumPrios; prio++) {
+            if (mask & (1u << prio)) {
+                ringInsert(rows_[level][prio], id, prio);
+            }
+        }
+        rowMask_[level] |= mask;
+    }
+
+    void removeFromRow(uint32_t id, uint8_t mask) {
+        unsigned level = static_cast<unsigned>(classes_[id].level);
+        for (unsigned prio = 0; prio < kNumPrios; prio++) {
+            if (!(mask & (1u << prio))) continue;
+            ringRemove(rows_[level][prio], id, prio);
+            if (rows_[level][prio].empty()) {
+                rowMask_[level] &= static_cast<uint8_t>(~(1u << prio));
+            }
+        }
+    }
+
+    // Insert just behind the head, i.e. last in round-robin order
+    void ringInsert(Ring& ring, uint32_t id, unsigned prio) {
+        HtbClass& cl = classes_[id];
+        if (ring.empty()) {
+            cl.next[prio] = id;
+            cl.prev[prio] = id;
+            ring.head = id;
+            return;
+        }
+        uint32_t tail = classes_[ring.head].prev[prio];
+        cl.next[prio] = ring.head;
+        cl.prev[prio] = tail;
+        classes_[tail].next[prio] = id;
+        classes_[ring.head].prev[prio] = id;
+    }
+
+    void ringRemove(Ring& ring, uint32_t id, unsigned prio) {
+        HtbClass& cl = classes_[id];
+        if (cl.next[prio] == id) {
+            ring.head = kNoClass;
+            return;
+        }
+        classes_[cl.prev[prio]].next[prio] = cl.next[prio];
+        classes_[cl.next[prio]].prev[prio] = cl.prev[prio];
+        if (ring.head == id) {
+            ring.head = cl.next[prio];
+        }
+    }
+
+    PacketSlotPool pool_;
+    std::vector<HtbClass> classes_;
+    std::unordered_map<uint32_t, uint32_t> flowClass_;
+    uint32_t defaultClass_;
+
+    Ring rows_[kMaxDepth][kNumPrios];  // Classes sending from their own rate
+    uint8_t rowMask_[kMaxDepth];       // Non-empty rows, per level
+    std::set<std::pair<int64_t, uint32_t>> waiting_;  // Classes not in CAN_SEND
+
+    size_t totalDropped_;
+    mutable std::mutex mutex_;
+};
+
+#endif // HTB_QUEUE_H
@@ -0,0 +1,49 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+// Serialization clock of one wire. Every shaper sending on the link books
+// its packets here, so shapers that share a Link take turns on it and their
+// total output never exceeds its capacity, however many threads send.
+// Booking is one compare-and-swap on the time the wire goes idle.
+class Link {
+public:
+    using Clock = std::chrono::high_resolution_clock;
+
+    explicit Link(uint64_t capacity)   // bits per second
+        : capacity_(std::max<uint64_t>(capacity, 1))
+        , idleAt_(0) {}
+
+    // Books the wire for 'bits' after whatever is already booked and
+    // returns when they start to go out. The caller waits until
+    // start + serializationTime(bits) before sending more.
+    Clock::time_point reserve(uint64_t bits) {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now().time_since_epoch()).count();
+        int64_t duration = static_cast<int64_t>(serializationNanos(bits));
+        int64_t idleAt = idleAt_.load(std::memory_order_relaxed);
+        int64_t start;
+        do {
+            start = std::max(idleAt, now);
+        } while (!idleAt_.compare_exchange_weak(idleAt, start + duration,
+                                                std::memory_order_relaxed));
+        return Clock::time_point(std::chrono::duration_cast<Clock::duration>(
+            std::chrono::nanoseconds(start)));
+    }
+
+    uint64_t serializationNanos(uint64_t bits) const {
+        return bits * 1000000000ULL / capacity_;
+    }
+
+    uint64_t getCapacity() const { return capacity_; }
+
+private:
+    uint64_t capacity_;
+    std::atomic<int64_t> idleAt_;   // ns (Clock epoch) the wire is next free
+};
+
+#endif // LINK_H
@@ -0,0 +1,118 @@
+#ifndef MULTI_QUEUE_DISCIPLINE_H
+#define MULTI_QUEUE_DISCIPLINE_H
+
+#include "QueueDiscipline.h"
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+// A set of independent TX queues behind one enqueue point, as on a
+// multi-queue NIC. Each packet goes to the queue picked by a hash of its
+// flow id (RSS/XPS-style steering), so a flow always lands in the same
+// queue and keeps its order however many queues there are. Each queue runs
+// its own discipline and is drained by its own MultiQueueShaper thread,
+// with no state shared between queues.
+//
+// The hash is the Murmur3 finalizer rather than a NIC's Toeplitz hash: flow
+// ids are the whole key here, and it spreads sequential ids just as well.
+//
+// tryDequeue() visits the queues round robin, so the set still works as a
+// single discipline behind one TrafficShaper.
+class MultiQueueDiscipline final : public QueueDiscipline {
+public:
+    explicit MultiQueueDiscipline(std::vector<std::shared_ptr<QueueDiscipline>> queues)
+        : queues_(std::move(queues))
+        , next_(0) {
+        // Drops inside a TX queue are reported through this set's callback
+        for (auto& queue : queues_) {
+            queue->setDropCallback([this](const Packet& packet) { notifyDrop(packet); });
+        }
+    }
+
+    // TX queue that carries the flow, out of 'numQueues'
+    static size_t queueFor(uint32_t flowId, size_t numQueues) {
+        uint32_t hash = flowId;
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+        return numQueues > 1 ? hash % numQueues : 0;
+    }
+
+    size_t queueFor(uint32_t flowId) const {
+        return queueFor(flowId, queues_.size());
+    }
+
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        return queues_[queueFor(packet->getFlowId())]->enqueue(std::move(packet));
+    }
+
+    std::shared_ptr<Packet> tryDequeue() override {
+        size_t start = next_.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < queues_.size(); i++) {
+            if (auto packet = queues_[(start + i) % queues_.size()]->tryDequeue()) {
+                return packet;
+            }
+        }
+        return nullptr;
+    }
+
+    int64_t nextEligibleTime() const override {
+        int64_t next = kNeverEligible;
+        for (const auto& queue : queues_) {
+            next = std::min(next, queue->nextEligibleTime());
+        }
+        return next;
+    }
+
+    size_t size() const override {
+        size_t total = 0;
+        for (const auto& queue : queues_) {
+            total += queue->size();
+        }
+        return total;
+    }
+
+    bool empty() const override {
+        return std::all_of(queues_.begin(), queues_.end(),
+                           [](const auto& queue) { return queue->empty(); });
+    }
+
+    size_t getTotalDropped() const override {
+        size_t total = 0;
+        for (const auto& queue : queues_) {
+            total += queue->getTotalDropped();
+        }
+        return total;
+    }
+
+    // Per-queue telemetry merged, as ShardedPacketQueue merges its shards
+    QueueTelemetrySnapshot readTelemetry() override {
+        QueueTelemetrySnapshot merged;
+        for (auto& queue : queues_) {
+            merged.add(queue->readTelemetry());
+        }
+        return merged;
+    }
+
+    void shutdown() override {
+        for (auto& queue : queues_) {
+            queue->shutdown();
+        }
+    }
+
+    size_t getNumQueues() const { return queues_.size(); }
+
+    const std::shared_ptr<QueueDiscipline>& getQueue(size_t index) const {
+        return queues_[index];
+    }
+
+private:
+    std::vector<std::shared_ptr<QueueDiscipline>> queues_;
+    std::atomic<size_t> next_;   // Round-robin start of tryDequeue()
+};
+
+#endif // MULTI_QUEUE_DISCIPLINE_H
@@ -0,0 +1,90 @@
+#ifndef MULTI_QUEUE_SHAPER_H
+#define MULTI_QUEUE_SHAPER_H
+
+#include "MultiQueueDiscipline.h"
+#include "TrafficShaper.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+// One TrafficShaper thread per TX queue of a MultiQueueDiscipline, so
+// shaping scales with cores instead of being capped by a single thread.
+// Each thread dequeues only from its own queue and serves only the flows
+// hashed to it, so a flow's packets are sent in order by one thread.
+//
+// The aggregate limiter, if any, is shared by every thread and caps their
+// total rate. It must be thread-safe; ShardedTokenBucket avoids contention
+// on it at high thread counts. When it is null each queue sends as fast as
+// its discipline releases packets.
+//
+// All threads serialize onto one Link of the given capacity, so they share
+// the wire as a multi-queue NIC's rings do and their combined output never
+// exceeds it, with or without an aggregate limiter.
+class MultiQueueShaper {
+public:
+    MultiQueueShaper(std::shared_ptr<MultiQueueDiscipline> queues,
+                     std::shared_ptr<RateLimiter> aggregateLimiter,
+                     uint64_t linkCapacity)  // bits per second, shared by all queues
+        : queues_(queues) {
+        auto link = std::make_shared<Link>(linkCapacity);
+        for (size_t i = 0; i < queues_->getNumQueues(); i++) {
+            shapers_.push_back(std::make_shared<TrafficShaper>(
+                queues_->getQueue(i), aggregateLimiter, link));
+        }
+    }
+
+    void addFlow(std::shared_ptr<Flow> flow) {
+        shapers_[queues_->queueFor(flow->getFlowId())]->addFlow(flow);
+    }
+
+    // Packets each TX thread sends per batch. Must be set before start().
+    void setBatchSize(size_t batchSize) {
+        for (auto& shaper : shapers_) {
+            shaper->setBatchSize(batchSize);
+        }
+    }
+
+    void start() {
+        for (auto& shaper : shapers_) {
+            shaper->start();
+        }
+    }
+
+    void stop() {
+        for (auto& shaper : shapers_) {
+            shaper->stop();
+        }
+    }
+
+    uint64_t getPacketsTransmitted() const {
+        uint64_t total = 0;
+        for (const auto& shaper : shapers_) {
+            total += shaper->getPacketsTransmitted();
+        }
+        return total;
+    }
+
+    uint64_t getBytesTransmitted() const {
+        uint64_t total = 0;
+        for (const auto& shaper : shapers_) {
+            total += shaper->getBytesTransmitted();
+        }
+        return total;
+    }
+
+    uint64_t getPacketsDropped() const {
+        uint64_t total = 0;
+        for (const auto& shaper : shapers_) {
+            total += shaper->getPacketsDropped();
+        }
+        return total;
+    }
+
+    size_t getNumQueues() const { return shapers_.size(); }
+
+private:
+    std::shared_ptr<MultiQueueDiscipline> queues_;
+    std::vector<std::shared_ptr<TrafficShaper>> shapers_;
+};
+
+#endif // MULTI_QUEUE_SHAPER_H
@@ -11,6 +11,15 @@ enum class PacketPriority {
     CRITICAL = 3
 };
 
+// Policing color set by a ColorMarker (RFC 2697/2698). Green is within the
+// committed rate, yellow exceeds it but is within the excess/peak allowance,
+// red is out of contract.
+enum class PacketColor : uint8_t {
+    GREEN = 0,
+    YELLOW = 1,
+    RED = 2
+};
+
 class Packet {
 public:
     using TimePoint = std::chrono::high_resolution_clock::time_point;
@@ -20,18 +29,31 @@ public:
         , size_(size)
         , priority_(priority)
         , creationTime_(std::chrono::high_resolution_clock::now())
+        , enqueueTime_()
         , transmissionTime_()
-        , dropped_(false) {}
+        , dropped_(false)
+        , ecnCapable_(false)
+        , ceMarked_(false)
+        , color_(PacketColor::GREEN) {}
 
     uint32_t getFlowId() const { return flowId_; }
     uint32_t getSize() const { return size_; }
     PacketPriority getPriority() const { return priority_; }
     TimePoint getCreationTime() const { return creationTime_; }
+    TimePoint getEnqueueTime() const { return enqueueTime_; }
     TimePoint getTransmissionTime() const { return transmissionTime_; }
     bool isDropped() const { return dropped_; }
+    bool isEcnCapable() const { return ecnCapable_; }
+    bool isCeMarked() const { return ceMarked_; }
+    PacketColor getColor() const { return color_; }
 
+    void setEnqueueTime(TimePoint time) { enqueueTime_ = time; }
     void setTransmissionTime(TimePoint time) { transmissionTime_ = time; }
     void markDropped() { dropped_ = true; }
+    void setEcnCapable(bool capable) { ecnCapable_ = capable; }
+    // Congestion Experienced: AQM signal used instead of a drop for ECT packets
+    void markCongestionExperienced() { ceMarked_ = true; }
+    void setColor(PacketColor color) { color_ = color; }
 
     // Calculate delay in milliseconds
     double getDelay() const {
@@ -48,8 +70,12 @@ private:
     uint32_t size_;           // Size in bytes
     PacketPriority priority_;
     TimePoint creationTime_;
+    TimePoint enqueueTime_;   // Set by disciplines that track sojourn time
     TimePoint transmissionTime_;
     bool dropped_;
+    bool ecnCapable_;         // ECT codepoint set by the sender
+    bool ceMarked_;           // CE codepoint set by an AQM stage
+    PacketColor color_;       // Set by an ingress color marker
 };
 
 #endif // PACKET_H
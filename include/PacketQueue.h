@@ -2,6 +2,7 @@
 #define PACKET_QUEUE_H
 
 #include "Packet.h"
+#include "QueueDiscipline.h"
 #include <queue>
 #include <mutex>
 #include <condition_variable>
@@ -20,7 +21,7 @@ struct PacketComparator {
     }
 };
 
-class PacketQueue {
+class PacketQueue final : public QueueDiscipline {
 public:
     PacketQueue(size_t maxSize = 1000)
         : maxSize_(maxSize)
@@ -29,7 +30,9 @@ public:
         , shutdown_(false) {}
 
     // Enqueue a packet (returns false if queue is full)
-    bool enqueue(std::shared_ptr<Packet> packet) {
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        // Timestamp outside the lock; telemetry tolerates slight reordering
+        auto now = std::chrono::high_resolution_clock::now();
         std::lock_guard<std::mutex> lock(mutex_);
         
         if (currentSize_ >= maxSize_) {
@@ -37,8 +40,10 @@ public:
             return false;  // Queue full, packet dropped
         }
         
+        packet->setEnqueueTime(now);
         queue_.push(packet);
         currentSize_++;
+        telemetry_.recordEnqueue(currentSize_, toNanos(now));
         cv_.notify_one();
         return true;
     }
@@ -55,11 +60,13 @@ public:
         auto packet = queue_.top();
         queue_.pop();
         currentSize_--;
+        recordDeparture(*packet, nowNanos());
         return packet;
     }
 
     // Try to dequeue without blocking
-    std::shared_ptr<Packet> tryDequeue() {
+    std::shared_ptr<Packet> tryDequeue() override {
+        int64_t now = nowNanos();
         std::lock_guard<std::mutex> lock(mutex_);
         
         if (queue_.empty()) {
@@ -69,31 +76,36 @@ public:
         auto packet = queue_.top();
         queue_.pop();
         currentSize_--;
+        recordDeparture(*packet, now);
         return packet;
     }
 
-    size_t size() const {
+    size_t size() const override {
         std::lock_guard<std::mutex> lock(mutex_);
         return currentSize_;
     }
 
-    bool empty() const {
+    bool empty() const override {
         std::lock_guard<std::mutex> lock(mutex_);
         return queue_.empty();
     }
 
-    size_t getTotalDropped() const {
+    size_t getTotalDropped() const override {
         std::lock_guard<std::mutex> lock(mutex_);
         return totalDropped_;
     }
 
-    void shutdown() {
+    void shutdown() override {
         std::lock_guard<std::mutex> lock(mutex_);
         shutdown_ = true;
         cv_.notify_all();
     }
 
 private:
+    void recordDeparture(const Packet& packet, int64_t now) {
+        telemetry_.recordDequeue(currentSize_, now, now - toNanos(packet.getEnqueueTime()));
+    }
+
     std::priority_queue<std::shared_ptr<Packet>, 
                        std::vector<std::shared_ptr<Packet>>,
                        PacketComparator> queue_;
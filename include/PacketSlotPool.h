@@ -0,0 +1,97 @@
+#ifndef PACKET_SLOT_POOL_H
+#define PACKET_SLOT_POOL_H
+
+#include "Packet.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+// Fixed-capacity pool of packet slots threaded into intrusive FIFO lists.
+// Disciplines with many sub-queues keep one List per sub-queue and share a
+// single pool, so enqueue/dequeue never allocate regardless of how many
+// sub-queues exist. Not thread-safe; the owning discipline locks around it.
+class PacketSlotPool {
+public:
+    static constexpr uint32_t kNil = UINT32_MAX;
+
+    struct List {
+        uint32_t head = kNil;
+        uint32_t tail = kNil;
+        uint32_t packets = 0;
+        uint64_t bytes = 0;
+
+        bool empty() const { return head == kNil; }
+    };
+
+    explicit PacketSlotPool(size_t capacity)
+        : slots_(capacity)
+        , freeHead_(capacity > 0 ? 0 : kNil)
+        , used_(0) {
+        for (size_t i = 0; i < capacity; i++) {
+            slots_[i].next = (i + 1 < capacity) ? static_cast<uint32_t>(i + 1) : kNil;
+        }
+    }
+
+    size_t capacity() const { return slots_.size(); }
+    size_t used() const { return used_; }
+    bool full() const { return freeHead_ == kNil; }
+
+    // Append a packet to the tail of a list (caller checks full() first)
+    void push(List& list, std::shared_ptr<Packet> packet) {
+        uint32_t index = freeHead_;
+        Slot& slot = slots_[index];
+        freeHead_ = slot.next;
+
+        list.bytes += packet->getSize();
+        list.packets++;
+        slot.packet = std::move(packet);
+        slot.next = kNil;
+
+        if (list.tail == kNil) {
+            list.head = index;
+        } else {
+            slots_[list.tail].next = index;
+        }
+        list.tail = index;
+        used_++;
+    }
+
+    // Remove the packet at the head of a list (nullptr if empty)
+    std::shared_ptr<Packet> pop(List& list) {
+        if (list.head == kNil) {
+            return nullptr;
+        }
+
+        uint32_t index = list.head;
+        Slot& slot = slots_[index];
+        auto packet = std::move(slot.packet);
+
+        list.head = slot.next;
+        if (list.head == kNil) {
+            list.tail = kNil;
+        }
+        list.bytes -= packet->getSize();
+        list.packets--;
+
+        slot.next = freeHead_;
+        freeHead_ = index;
+        used_--;
+        return packet;
+    }
+
+    const std::shared_ptr<Packet>& front(const List& list) const {
+        return slots_[list.head].packet;
+    }
+
+private:
+    struct Slot {
+        std::shared_ptr<Packet> packet;
+        uint32_t next;
+    };
+
+    std::vector<Slot> slots_;
+    uint32_t freeHead_;
+    size_t used_;
+};
+
+#endif // PACKET_SLOT_POOL_H
@@ -0,0 +1,217 @@
+#ifndef PIFO_QUEUE_H
+#define PIFO_QUEUE_H
+
+#include "QueueDiscipline.h"
+#include "PacketSlotPool.h"
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+// What a rank function sees besides the packet: the enqueue time (ns) and
+// the rank of the last packet dequeued, which fair-queueing ranks use as
+// their virtual time
+struct PifoContext {
+    int64_t now;
+    uint64_t virtualTime;
+};
+
+using PifoRankFunction = std::function<uint64_t(const Packet&, const PifoContext&)>;
+
+// Push-In-First-Out queue (Sivaraman et al., SIGCOMM 2016): a rank function
+// computes each packet's rank at enqueue and the lowest rank leaves first,
+// ties in arrival order. The scheduling policy is entirely the rank
+// function; see PifoRanks.h for FIFO, fair queueing, EDF, SRPT and LSTF.
+//
+// Ranks go into numBuckets FIFO buckets of 2^rankShift ranks each, over a
+// window that starts at the lowest queued bucket and slides up as it
+// drains. A hierarchical bitmap of non-empty buckets (64-way, as in Eiffel)
+// finds the lowest one in a few word scans, so enqueue and dequeue are
+// O(log64 numBuckets). Ranks below the window go to its first bucket and
+// ranks past its end to its last; getClampedRanks() counts the latter.
+// With rankShift 0 and ranks that fit the window the order is exact.
+//
+// Rank is the rank callable: PifoRankFunction by default (PifoQueue), or a
+// concrete functor so that it inlines into enqueue. It is called under the
+// queue lock, so it may keep per-flow state of its own.
+template <typename Rank = PifoRankFunction>
+class BasicPifoQueue final : public QueueDiscipline {
+public:
+    BasicPifoQueue(Rank rank,
+                   size_t maxSize = 1000,
+                   size_t numBuckets = 65536,
+                   unsigned rankShift = 0)
+        : rank_(std::move(rank))
+        , pool_(maxSize)
+        , buckets_(numBuckets > 0 ? numBuckets : 1)
+        , occupied_(buckets_.size())
+        , rankShift_(std::min(rankShift, 63u))
+        , base_(0)
+        , virtualTime_(0)
+        , totalDropped_(0)
+        , clampedRanks_(0) {}
+
+    // Tail drop when the buffer is full; the rank is not computed then
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        auto now = std::chrono::high_resolution_clock::now();
+        packet->setEnqueueTime(now);
+        return enqueueAt(std::move(packet), toNanos(now));
+    }
+
+    std::shared_ptr<Packet> tryDequeue() override {
+        return tryDequeueAt(nowNanos());
+    }
+
+    // enqueue/tryDequeue on a caller-supplied timeline (ns), for simulation
+    bool enqueueAt(std::shared_ptr<Packet> packet, int64_t nowNs) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (pool_.full()) {
+            totalDropped_++;
+            return false;
+        }
+
+        uint64_t bucket = rank_(*packet, PifoContext{nowNs, virtualTime_}) >> rankShift_;
+        if (pool_.used() == 0) {
+            base_ = bucket;
+        } else if (bucket < base_) {
+            bucket = base_;
+        } else if (bucket - base_ >= buckets_.size()) {
+            bucket = base_ + buckets_.size() - 1;
+            clampedRanks_++;
+        }
+
+        size_t index = bucket % buckets_.size();
+        if (buckets_[index].empty()) {
+            occupied_.set(index);
+        }
+        pool_.push(buckets_[index], std::move(packet));
+        telemetry_.recordEnqueue(pool_.used(), nowNs);
+        return true;
+    }
+
+    std::shared_ptr<Packet> tryDequeueAt(int64_t nowNs) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (pool_.used() == 0) {
+            telemetry_.recordOccupancy(0, nowNs);
+            return nullptr;
+        }
+
+        // Lowest occupied bucket at or after the window start, wrapping once
+        size_t start = base_ % buckets_.size();
+        size_t index = occupied_.findFrom(start);
+        if (index == RankBitmap::kNone) {
+            index = occupied_.findFrom(0);
+        }
+        base_ += (index + buckets_.size() - start) % buckets_.size();
+        virtualTime_ = base_ << rankShift_;
+
+        auto packet = pool_.pop(buckets_[index]);
+        if (buckets_[index].empty()) {
+            occupied_.clear(index);
+        }
+        telemetry_.recordDequeue(pool_.used(), nowNs,
+                                 nowNs - toNanos(packet->getEnqueueTime()));
+        return packet;
+    }
+
+    size_t size() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used();
+    }
+
+    bool empty() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used() == 0;
+    }
+
+    size_t getTotalDropped() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return totalDropped_;
+    }
+
+    // Packets whose rank was past the end of the window
+    size_t getClampedRanks() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return clampedRanks_;
+    }
+
+private:
+    // One bit per bucket, plus a summary level per 64 words above it
+    class RankBitmap {
+    public:
+        static constexpr size_t kNone = SIZE_MAX;
+
+        explicit RankBitmap(size_t bits) {
+            do {
+                bits = (bits + 63) / 64;
+                levels_.emplace_back(bits, 0);
+            } while (bits > 1);
+        }
+
+        void set(size_t bit) {
+            for (auto& level : levels_) {
+                uint64_t& word = level[bit / 64];
+                bool wasEmpty = word == 0;
+                word |= 1ULL << (bit % 64);
+                if (!wasEmpty) {
+                    return;
+                }
+                bit /= 64;
+            }
+        }
+
+        void clear(size_t bit) {
+            for (auto& level : levels_) {
+                uint64_t& word = level[bit / 64];
+                word &= ~(1ULL << (bit % 64));
+                if (word != 0) {
+                    return;
+                }
+                bit /= 64;
+            }
+        }
+
+        // First set bit at or after 'bit', kNone if there is none
+        size_t findFrom(size_t bit) const {
+            for (size_t level = 0; level < levels_.size(); level++) {
+                size_t word = bit / 64;
+                if (word >= levels_[level].size()) {
+                    return kNone;
+                }
+                uint64_t bits = levels_[level][word] & (~0ULL << (bit % 64));
+                if (bits != 0) {
+                    bit = word * 64 + __builtin_ctzll(bits);
+                    while (level-- > 0) {
+                        bit = bit * 64 + __builtin_ctzll(levels_[level][bit]);
+                    }
+                    return bit;
+                }
+                bit = word + 1;
+            }
+            return kNone;
+        }
+
+    private:
+        std::vector<std::vector<uint64_t>> levels_;
+    };
+
+    Rank rank_;
+    PacketSlotPool pool_;
+    std::vector<PacketSlotPool::List> buckets_;
+    RankBitmap occupied_;
+    unsigned rankShift_;
+    uint64_t base_;          // Absolute bucket number of the window start
+    uint64_t virtualTime_;   // Rank of the last dequeue, to bucket precision
+
+    size_t totalDropped_;
+    size_t clampedRanks_;
+    mutable std::mutex mutex_;
+};
+
+using PifoQueue = BasicPifoQueue<PifoRankFunction>;
+
+#endif // PIFO_QUEUE_H
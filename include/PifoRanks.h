@@ -0,0 +1,100 @@
+#ifndef PIFO_RANKS_H
+#define PIFO_RANKS_H
+
+#include "PifoQueue.h"
+#include <unordered_map>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+// Rank functions for PifoQueue. Each returns a PifoRankFunction whose state,
+// if any, lives in the returned callable. Time-based ranks are in
+// nanoseconds, byte-based ranks in bytes; pick the queue's rankShift so the
+// window covers the spread of ranks that are queued at once.
+namespace PifoRanks {
+
+// Arrival order
+inline PifoRankFunction fifo() {
+    return [](const Packet&, const PifoContext& context) {
+        return static_cast<uint64_t>(context.now);
+    };
+}
+
+// Weight of one share in fairQueueing(): weights are fixed point, so
+// shares need not be whole numbers
+constexpr uint32_t kShare = 256;
+
+// Start-time fair queueing, the PIFO form of weighted fair sharing (DRR's
+// byte shares without its rounds). A packet's rank is its virtual start:
+// the later of the virtual time and the end of its flow's previous packet,
+// each packet taking size * kShare / weight (rounded up), so a flow of one
+// share advances by its bytes. Flows without a weight get one share.
+inline PifoRankFunction fairQueueing(std::unordered_map<uint32_t, uint32_t> weights = {}) {
+    struct State {
+        std::unordered_map<uint32_t, uint32_t> weights;
+        std::unordered_map<uint32_t, uint64_t> lastFinish;
+    };
+    auto state = std::make_shared<State>();
+    state->weights = std::move(weights);
+    return [state](const Packet& packet, const PifoContext& context) {
+        auto weight = state->weights.find(packet.getFlowId());
+        uint64_t& finish = state->lastFinish[packet.getFlowId()];
+        uint64_t start = std::max(context.virtualTime, finish);
+        uint64_t divisor = weight != state->weights.end() ? std::max(weight->second, 1u) : kShare;
+        finish = start + (packet.getSize() * uint64_t{kShare} + divisor - 1) / divisor;
+        return start;
+    };
+}
+
+// Earliest deadline first: the deadline is the enqueue time plus the flow's
+// latency budget. Flows without a budget get 'defaultBudget'.
+inline PifoRankFunction edf(std::unordered_map<uint32_t, std::chrono::microseconds> budgets,
+                            std::chrono::microseconds defaultBudget = std::chrono::seconds(1)) {
+    return [budgets = std::move(budgets), defaultBudget](const Packet& packet,
+                                                         const PifoContext& context) {
+        auto budget = budgets.find(packet.getFlowId());
+        auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            budget != budgets.end() ? budget->second : defaultBudget).count();
+        return static_cast<uint64_t>(context.now + nanos);
+    };
+}
+
+// Shortest remaining processing time: the rank is the bytes the flow still
+// has to send after this packet. Flows of unknown size are ranked by the
+// bytes they have already sent instead (least attained service, the usual
+// size-oblivious stand-in for SRPT).
+inline PifoRankFunction srpt(std::unordered_map<uint32_t, uint64_t> flowSizes = {}) {
+    struct State {
+        std::unordered_map<uint32_t, uint64_t> flowSizes;
+        std::unordered_map<uint32_t, uint64_t> sent;
+    };
+    auto state = std::make_shared<State>();
+    state->flowSizes = std::move(flowSizes);
+    return [state](const Packet& packet, const PifoContext&) {
+        uint64_t& sent = state->sent[packet.getFlowId()];
+        sent += packet.getSize();
+        auto size = state->flowSizes.find(packet.getFlowId());
+        if (size == state->flowSizes.end()) {
+            return sent - packet.getSize();
+        }
+        return size->second > sent ? size->second - sent : 0;
+    };
+}
+
+// Least slack time first (Mittal et al., NSDI 2016): the deadline less the
+// packet's own transmission time on a link of 'linkRate' bytes/sec, so of two
+// packets due together the longer one starts first
+inline PifoRankFunction lstf(std::unordered_map<uint32_t, std::chrono::microseconds> budgets,
+                             uint64_t linkRate,
+                             std::chrono::microseconds defaultBudget = std::chrono::seconds(1)) {
+    auto deadline = edf(std::move(budgets), defaultBudget);
+    uint64_t rate = std::max<uint64_t>(linkRate, 1);
+    return [deadline, rate](const Packet& packet, const PifoContext& context) {
+        return deadline(packet, context) - packet.getSize() * 1000000000ULL / rate;
+    };
+}
+
+} // namespace PifoRanks
+
+#endif // PIFO_RANKS_H
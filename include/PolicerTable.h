@@ -0,0 +1,194 @@
+#ifndef POLICER_TABLE_H
+#define POLICER_TABLE_H
+
+#include "RateLimiter.h"
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Per-flow policers for many flows at once. Bucket state is stored as
+// parallel arrays (structure of arrays) indexed by a dense slot per flow,
+// and refilled for all flows in one pass per tick, which the compiler turns
+// into SIMD code. The per-packet check is then a lookup and a
+// compare-and-swap, with no clock read and no lock.
+//
+// Each bucket is two running totals in bytes: the credit granted so far,
+// a plain array written only by the refill pass, and the debit charged so
+// far, the one atomic column, advanced by conform(). Tokens are credit -
+// debit, capped at the burst. The refill only adds rate * elapsed to every
+// credit and never reads the debits; conform() applies the cap instead, by
+// forfeiting any credit beyond the burst when it charges a packet. Totals
+// are exact up to 2^53 bytes per flow.
+//
+// Refill passes and setContract() are serialized by a mutex. Contracts
+// must all be in place before traffic starts.
+//
+// Refill granularity is the tick: a bucket smaller than rate * tick caps
+// the achieved rate below the contract.
+class PolicerTable {
+public:
+    PolicerTable()
+        : lastRefill_(kUnset)
+        , conforming_(0)
+        , exceeding_(0)
+        , running_(false)
+        , tick_(std::chrono::milliseconds(1)) {}
+
+    ~PolicerTable() {
+        stop();
+    }
+
+    // Add or replace a flow's contract (bytes/sec, bytes). Starts full.
+    void setContract(uint32_t flowId, uint64_t rate, uint64_t burst) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = slots_.find(flowId);
+        uint32_t slot;
+        if (it != slots_.end()) {
+            slot = it->second;
+        } else {
+            slot = static_cast<uint32_t>(credit_.size());
+            slots_[flowId] = slot;
+            credit_.push_back(0.0);
+            debit_.emplace_back();
+            ratePerNano_.push_back(0.0);
+            burst_.push_back(0.0);
+        }
+        ratePerNano_[slot] = static_cast<double>(rate) / 1e9;
+        burst_[slot] = static_cast<double>(burst);
+        credit_[slot] = debit_[slot].value.load(std::memory_order_relaxed) + burst_[slot];
+    }
+
+    // Debit the flow's bucket if it holds the packet. Flows without a
+    // contract always conform.
+    bool conform(uint32_t flowId, uint32_t bytes) {
+        auto it = slots_.find(flowId);
+        if (it == slots_.end()) {
+            return true;
+        }
+        uint32_t slot = it->second;
+        double credit = loadCredit(credit_[slot]);
+        double full = credit - burst_[slot];   // Debit that leaves the bucket full
+        std::atomic<double>& debit = debit_[slot].value;
+        double charged = debit.load(std::memory_order_relaxed);
+        double next;
+        do {
+            double base = std::max(charged, full);   // Credit beyond the burst is forfeit
+            if (credit - base < bytes) {
+                exceeding_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            next = base + bytes;
+        } while (!debit.compare_exchange_weak(charged, next, std::memory_order_relaxed));
+        conforming_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Refill every bucket up to nowNs in a single pass
+    void refillAt(uint64_t nowNs) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (lastRefill_ == kUnset || nowNs <= lastRefill_) {
+            if (lastRefill_ == kUnset) lastRefill_ = nowNs;
+            return;
+        }
+        double elapsed = static_cast<double>(nowNs - lastRefill_);
+        lastRefill_ = nowNs;
+
+        double* credit = credit_.data();
+        const double* rate = ratePerNano_.data();
+        size_t n = credit_.size();
+        for (size_t i = 0; i < n; i++) {
+            credit[i] += rate[i] * elapsed;
+        }
+    }
+
+    void refill() {
+        refillAt(RateLimiter::nowNanos());
+    }
+
+    // Refill from a background thread every 'tick'
+    void start(std::chrono::microseconds tick = std::chrono::milliseconds(1)) {
+        if (running_) return;
+
+        tick_ = tick;
+        running_ = true;
+        refill();
+        thread_ = std::thread(&PolicerTable::refillLoop, this);
+    }
+
+    void stop() {
+        if (!running_) return;
+
+        running_ = false;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    // Current tokens of a flow's bucket as of the last refill (0 if none)
+    double getTokens(uint32_t flowId) const {
+        auto it = slots_.find(flowId);
+        if (it == slots_.end()) {
+            return 0.0;
+        }
+        uint32_t slot = it->second;
+        return std::min(loadCredit(credit_[slot]) -
+                            debit_[slot].value.load(std::memory_order_relaxed),
+                        burst_[slot]);
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return credit_.size();
+    }
+
+    uint64_t getConforming() const { return conforming_.load(std::memory_order_relaxed); }
+    uint64_t getExceeding() const { return exceeding_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint64_t kUnset = UINT64_MAX;
+
+    // A relaxed atomic that can live in a vector; only setContract() copies
+    // it, while no other thread is using the table
+    template <typename T>
+    struct Word {
+        std::atomic<T> value{};
+        Word() = default;
+        Word(const Word& other) : value(other.value.load(std::memory_order_relaxed)) {}
+    };
+
+    // A credit as the refill pass last stored it. The pass writes credits
+    // with plain (vector) stores so that it vectorizes; an aligned 8-byte
+    // store is never torn, so this reads either the old or the new value.
+    static double loadCredit(const double& credit) {
+        return *static_cast<const volatile double*>(&credit);
+    }
+
+    void refillLoop() {
+        while (running_) {
+            std::this_thread::sleep_for(tick_);
+            refill();
+        }
+    }
+
+    std::unordered_map<uint32_t, uint32_t> slots_;   // Flow id -> slot
+    std::vector<double> credit_;                     // Bytes granted, refill only
+    std::vector<Word<double>> debit_;                // Bytes charged
+    std::vector<double> ratePerNano_;                // Bytes/ns
+    std::vector<double> burst_;                      // Bytes
+    uint64_t lastRefill_;                            // ns, shared by all slots
+
+    std::atomic<uint64_t> conforming_;
+    std::atomic<uint64_t> exceeding_;
+
+    std::atomic<bool> running_;
+    std::chrono::microseconds tick_;
+    std::thread thread_;
+    mutable std::mutex mutex_;   // Serializes refill passes and setContract()
+};
+
+#endif // POLICER_TABLE_H
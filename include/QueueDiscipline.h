@@ -0,0 +1,81 @@
+#ifndef QUEUE_DISCIPLINE_H
+#define QUEUE_DISCIPLINE_H
+
+#include "Packet.h"
+#include "QueueTelemetry.h"
+#include <memory>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+
+// Common interface for everything that sits between the traffic generator
+// and the shaper: the plain priority queue, FQ-CoDel, and so on. The shaper
+// only enqueues, dequeues and asks when the next packet will be eligible,
+// so any scheduler can be plugged in behind it.
+class QueueDiscipline {
+public:
+    using DropCallback = std::function<void(const Packet&)>;
+
+    static constexpr int64_t kNeverEligible = INT64_MAX;
+
+    virtual ~QueueDiscipline() = default;
+
+    // Enqueue a packet (returns false if the packet itself was rejected)
+    virtual bool enqueue(std::shared_ptr<Packet> packet) = 0;
+
+    // Try to dequeue without blocking (nullptr if nothing is eligible)
+    virtual std::shared_ptr<Packet> tryDequeue() = 0;
+
+    // Earliest time (ns, high_resolution_clock) at which tryDequeue() may
+    // return a packet: now or earlier if one is eligible, kNeverEligible if
+    // nothing is queued. Work-conserving disciplines never hold packets back.
+    virtual int64_t nextEligibleTime() const {
+        return empty() ? kNeverEligible : nowNanos();
+    }
+
+    virtual size_t size() const = 0;
+    virtual bool empty() const = 0;
+    virtual size_t getTotalDropped() const = 0;
+
+    // Wake consumers blocked on the queue. Disciplines that never block
+    // have nothing to do.
+    virtual void shutdown() {}
+
+    // Called for packets the discipline had already accepted and later
+    // discarded (AQM drops, head drops on overflow). Packets rejected by
+    // enqueue() are reported to the caller through its return value instead.
+    // Must be set before traffic starts.
+    void setDropCallback(DropCallback callback) {
+        dropCallback_ = std::move(callback);
+    }
+
+    // Occupancy and sojourn telemetry accumulated since the previous call.
+    // Lock-free; meant for a single reader such as the statistics collector.
+    virtual QueueTelemetrySnapshot readTelemetry() {
+        return telemetry_.readAndReset(nowNanos());
+    }
+
+protected:
+    static int64_t toNanos(Packet::TimePoint time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            time.time_since_epoch()).count();
+    }
+
+    static int64_t nowNanos() {
+        return toNanos(std::chrono::high_resolution_clock::now());
+    }
+
+    void notifyDrop(const Packet& packet) {
+        if (dropCallback_) {
+            dropCallback_(packet);
+        }
+    }
+
+    QueueTelemetry telemetry_;
+
+private:
+    DropCallback dropCallback_;
+};
+
+#endif // QUEUE_DISCIPLINE_H
@@ -0,0 +1,195 @@
+#ifndef QUEUE_TELEMETRY_H
+#define QUEUE_TELEMETRY_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// Result of one telemetry read; covers the window since the previous read
+struct QueueTelemetrySnapshot {
+    static constexpr size_t kSojournBuckets = 32;
+
+    size_t highWatermark = 0;        // Peak occupancy (packets) in the window
+    double averageOccupancy = 0.0;   // Time-weighted mean occupancy (packets)
+    double windowSeconds = 0.0;
+    // Bucket 0 counts sojourn times below 1.024us; bucket k counts
+    // [1.024us * 2^(k-1), 1.024us * 2^k); the last bucket is open-ended
+    std::array<uint64_t, kSojournBuckets> sojournHistogram{};
+
+    static double bucketUpperBoundMicros(size_t bucket) {
+        return 1.024 * static_cast<double>(1ULL << bucket);
+    }
+
+    uint64_t sojournSamples() const {
+        uint64_t total = 0;
+        for (uint64_t count : sojournHistogram) total += count;
+        return total;
+    }
+
+    // Upper bound (us) of the bucket holding the given quantile, 0 if empty
+    double sojournPercentileMicros(double quantile) const {
+        uint64_t total = sojournSamples();
+        if (total == 0) return 0.0;
+
+        uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(total));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kSojournBuckets; i++) {
+            seen += sojournHistogram[i];
+            if (seen > rank) return bucketUpperBoundMicros(i);
+        }
+        return bucketUpperBoundMicros(kSojournBuckets - 1);
+    }
+
+    // Merge a snapshot covering the same window (e.g. another shard)
+    void add(const QueueTelemetrySnapshot& other) {
+        highWatermark += other.highWatermark;
+        averageOccupancy += other.averageOccupancy;
+        windowSeconds = std::max(windowSeconds, other.windowSeconds);
+        for (size_t i = 0; i < kSojournBuckets; i++) {
+            sojournHistogram[i] += other.sojournHistogram[i];
+        }
+    }
+};
+
+// Occupancy and sojourn-time counters maintained by a queue discipline on
+// every enqueue/dequeue, so that microbursts between statistics samples are
+// not lost.
+//
+// Updates must be serialized by the owner (they happen under the queue's own
+// lock); readAndReset() takes no lock and may run concurrently from a single
+// reader thread. The occupancy integral is published through a sequence
+// counter, so the reader always sees a consistent (area, occupancy, time)
+// triple and the time-weighted mean is exact. The high watermark and each
+// histogram bucket are reset by atomic exchange, so every update lands in
+// exactly one window.
+class QueueTelemetry {
+public:
+    static constexpr size_t kSojournBuckets = QueueTelemetrySnapshot::kSojournBuckets;
+
+    QueueTelemetry()
+        : sequence_(0)
+        , occupancy_(0)
+        , lastChangeNs_(-1)
+        , firstChangeNs_(-1)
+        , area_(0)
+        , highWatermark_(0)
+        , readAreaBase_(0)
+        , readTimeBase_(-1) {
+        for (auto& bucket : histogram_) bucket.store(0, std::memory_order_relaxed);
+    }
+
+    void recordEnqueue(size_t occupancyAfter, int64_t nowNs) {
+        updateOccupancy(occupancyAfter, nowNs);
+        if (occupancyAfter > highWatermark_.load(std::memory_order_relaxed)) {
+            raiseHighWatermark(occupancyAfter);
+        }
+    }
+
+    void recordDequeue(size_t occupancyAfter, int64_t nowNs, int64_t sojournNs) {
+        updateOccupancy(occupancyAfter, nowNs);
+        histogram_[bucketFor(sojournNs)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Occupancy change without a departure (drops, empty polls)
+    void recordOccupancy(size_t occupancy, int64_t nowNs) {
+        updateOccupancy(occupancy, nowNs);
+    }
+
+    QueueTelemetrySnapshot readAndReset(int64_t nowNs) {
+        uint64_t area;
+        uint64_t occupancy;
+        int64_t lastChange;
+        uint64_t begin;
+        do {
+            begin = sequence_.load(std::memory_order_acquire);
+            area = area_.load(std::memory_order_relaxed);
+            occupancy = occupancy_.load(std::memory_order_relaxed);
+            lastChange = lastChangeNs_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((begin & 1) != 0 || sequence_.load(std::memory_order_relaxed) != begin);
+
+        // Extend the integral to "now" with the occupancy still in effect
+        if (lastChange >= 0 && nowNs > lastChange) {
+            area += occupancy * static_cast<uint64_t>(nowNs - lastChange);
+        }
+
+        QueueTelemetrySnapshot snapshot;
+        int64_t windowStart = readTimeBase_ >= 0
+            ? readTimeBase_ : firstChangeNs_.load(std::memory_order_relaxed);
+        if (windowStart >= 0 && nowNs > windowStart) {
+            // A writer that read the clock just before us may publish a
+            // slightly smaller area than we extrapolated; never go negative
+            uint64_t windowArea = area > readAreaBase_ ? area - readAreaBase_ : 0;
+            int64_t window = nowNs - windowStart;
+            snapshot.windowSeconds = window / 1e9;
+            snapshot.averageOccupancy =
+                static_cast<double>(windowArea) / static_cast<double>(window);
+        }
+        readAreaBase_ = std::max(area, readAreaBase_);
+        readTimeBase_ = nowNs;
+
+        snapshot.highWatermark = highWatermark_.exchange(
+            static_cast<size_t>(occupancy), std::memory_order_relaxed);
+        for (size_t i = 0; i < kSojournBuckets; i++) {
+            snapshot.sojournHistogram[i] = histogram_[i].exchange(0, std::memory_order_relaxed);
+        }
+        return snapshot;
+    }
+
+private:
+    void updateOccupancy(size_t occupancyAfter, int64_t nowNs) {
+        uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        int64_t lastChange = lastChangeNs_.load(std::memory_order_relaxed);
+        if (lastChange < 0) {
+            firstChangeNs_.store(nowNs, std::memory_order_relaxed);
+        } else if (nowNs > lastChange) {
+            area_.store(area_.load(std::memory_order_relaxed) +
+                            occupancy_.load(std::memory_order_relaxed) *
+                                static_cast<uint64_t>(nowNs - lastChange),
+                        std::memory_order_relaxed);
+        }
+        occupancy_.store(occupancyAfter, std::memory_order_relaxed);
+        lastChangeNs_.store(std::max(nowNs, lastChange), std::memory_order_relaxed);
+
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    void raiseHighWatermark(size_t occupancy) {
+        size_t current = highWatermark_.load(std::memory_order_relaxed);
+        while (occupancy > current &&
+               !highWatermark_.compare_exchange_weak(current, occupancy,
+                                                     std::memory_order_relaxed));
+    }
+
+    static size_t bucketFor(int64_t sojournNs) {
+        uint64_t units = sojournNs > 0 ? static_cast<uint64_t>(sojournNs) >> 10 : 0;
+        if (units == 0) return 0;
+#if defined(__GNUC__) || defined(__clang__)
+        size_t width = 64 - static_cast<size_t>(__builtin_clzll(units));
+#else
+        size_t width = 0;
+        while (units) { width++; units >>= 1; }
+#endif
+        return std::min(width, kSojournBuckets - 1);
+    }
+
+    // Writer-published state
+    std::atomic<uint64_t> sequence_;
+    std::atomic<uint64_t> occupancy_;
+    std::atomic<int64_t> lastChangeNs_;
+    std::atomic<int64_t> firstChangeNs_;
+    std::atomic<uint64_t> area_;           // Cumulative packet-nanoseconds
+    std::atomic<size_t> highWatermark_;
+    std::array<std::atomic<uint64_t>, kSojournBuckets> histogram_;
+
+    // Reader-private state
+    uint64_t readAreaBase_;
+    int64_t readTimeBase_;
+};
+
+#endif // QUEUE_TELEMETRY_H
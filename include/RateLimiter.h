@@ -0,0 +1,68 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <chrono>
+#include <cstdint>
+
+// Interface shared by the token bucket variants so TrafficShaper can be
+// configured with any of them.
+//
+// Every operation has an ...At() form taking the current time in
+// nanoseconds. The plain forms read the steady clock; the At() forms let a
+// caller share one clock read across several calls or drive a limiter in
+// virtual time. A limiter must be used on a single timeline throughout.
+class RateLimiter {
+public:
+    virtual ~RateLimiter() = default;
+
+    // Try to consume tokens for a packet (tokens are bytes)
+    bool consume(uint32_t tokens) {
+        return consumeAt(tokens, nowNanos());
+    }
+
+    // Nanoseconds until consume(tokens) could succeed, 0 if it would now.
+    // Lets the shaper sleep until tokens are due instead of polling.
+    uint64_t nanosUntilAvailable(uint32_t tokens) {
+        return nanosUntilAvailableAt(tokens, nowNanos());
+    }
+
+    // Get current token count
+    uint64_t getTokens() {
+        return getTokensAt(nowNanos());
+    }
+
+    // Consume tokens for a batch of packets, in order, stopping at the first
+    // that does not conform; returns how many were charged. Each packet is
+    // checked as consume() would check it, so per-packet limits still hold.
+    uint32_t consumeBatch(const uint32_t* sizes, uint32_t count) {
+        return consumeBatchAt(sizes, count, nowNanos());
+    }
+
+    virtual bool consumeAt(uint32_t tokens, uint64_t nowNs) = 0;
+
+    // Limiters that take a lock per operation override this to take it once
+    // per batch
+    virtual uint32_t consumeBatchAt(const uint32_t* sizes, uint32_t count, uint64_t nowNs) {
+        uint32_t charged = 0;
+        while (charged < count && consumeAt(sizes[charged], nowNs)) {
+            charged++;
+        }
+        return charged;
+    }
+    virtual uint64_t nanosUntilAvailableAt(uint32_t tokens, uint64_t nowNs) = 0;
+    virtual uint64_t getTokensAt(uint64_t nowNs) = 0;
+
+    virtual uint64_t getRate() const = 0;        // bytes/sec
+    virtual uint64_t getBucketSize() const = 0;  // bytes
+
+    // Largest packet that can ever conform. A bucket never holds more than
+    // its size, so a larger packet would wait forever; the shaper drops it.
+    virtual uint64_t getMaxPacketSize() const { return getBucketSize(); }
+
+    static uint64_t nowNanos() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+};
+
+#endif // RATE_LIMITER_H
@@ -0,0 +1,129 @@
+#ifndef RATE_SCHEDULE_H
+#define RATE_SCHEDULE_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+
+// Piecewise-constant rate over time, for replaying rate-plan changes and
+// link-capacity events. Segment i runs at its rate from its start until the
+// next segment's start; times are nanoseconds from the start of the
+// schedule, and the first segment always starts at 0. A periodic schedule
+// repeats every period (24 h for a diurnal plan); otherwise the last rate
+// holds forever.
+//
+// A schedule is immutable once built and may be shared by several buckets.
+// Lookups take the caller's last segment index as a hint, so a caller
+// moving forward through time finds its segment in O(1).
+class RateSchedule {
+public:
+    static constexpr uint64_t kNever = UINT64_MAX;
+
+    // Segment in effect at an offset, and how long it lasts from there
+    struct Position {
+        size_t index;
+        uint64_t rate;          // bytes/sec
+        uint64_t untilNext;     // ns, kNever if the rate never changes again
+    };
+
+    explicit RateSchedule(uint64_t periodNanos = 0)
+        : period_(periodNanos) {}
+
+    // Append a segment; starts must increase (and lie within the period)
+    bool addSegment(uint64_t startNs, uint64_t rate) {
+        if (starts_.empty()) {
+            startNs = 0;
+        } else if (startNs <= starts_.back() || (period_ > 0 && startNs >= period_)) {
+            return false;
+        }
+        starts_.push_back(startNs);
+        rates_.push_back(rate);
+        return true;
+    }
+
+    // Read a trace with one "<seconds> <bytes/sec>" pair per line. Blank
+    // lines and '#' comments are skipped; a "period <seconds>" line makes
+    // the schedule repeat. Returns false on a malformed line or an empty or
+    // unreadable file.
+    bool loadTrace(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(file, line)) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string first;
+            if (!(fields >> first)) {
+                continue;
+            }
+            double seconds = 0.0;
+            if (first == "period") {
+                if (!(fields >> seconds) || seconds <= 0.0 || !starts_.empty()) {
+                    return false;
+                }
+                period_ = static_cast<uint64_t>(seconds * 1e9);
+                continue;
+            }
+            uint64_t rate = 0;
+            std::istringstream time(first);
+            if (!(time >> seconds) || seconds < 0.0 || !(fields >> rate) ||
+                !addSegment(static_cast<uint64_t>(seconds * 1e9), rate)) {
+                return false;
+            }
+        }
+        return !starts_.empty();
+    }
+
+    // Segment in effect 'offsetNs' after the start. 'hint' is the index
+    // returned by the previous lookup.
+    Position locate(uint64_t offsetNs, size_t hint = 0) const {
+        uint64_t offset = period_ > 0 ? offsetNs % period_ : offsetNs;
+        size_t index = hint;
+        if (!contains(index, offset)) {
+            index = hint + 1 < starts_.size() ? hint + 1 : 0;
+            if (!contains(index, offset)) {
+                index = static_cast<size_t>(std::upper_bound(starts_.begin(), starts_.end(),
+                                                             offset) - starts_.begin()) - 1;
+            }
+        }
+
+        Position position;
+        position.index = index;
+        position.rate = rates_[index];
+        if (index + 1 < starts_.size()) {
+            position.untilNext = starts_[index + 1] - offset;
+        } else if (period_ > 0 && starts_.size() > 1) {
+            position.untilNext = period_ - offset;
+        } else {
+            position.untilNext = kNever;
+        }
+        return position;
+    }
+
+    // Rate 'offsetNs' after the start
+    uint64_t rateAt(uint64_t offsetNs) const {
+        return locate(offsetNs).rate;
+    }
+
+    bool empty() const { return starts_.empty(); }
+    size_t size() const { return starts_.size(); }
+    uint64_t getPeriod() const { return period_; }
+
+private:
+    bool contains(size_t index, uint64_t offset) const {
+        return index < starts_.size() && starts_[index] <= offset &&
+               (index + 1 == starts_.size() || offset < starts_[index + 1]);
+    }
+
+    uint64_t period_;                // ns, 0 if the schedule does not repeat
+    std::vector<uint64_t> starts_;   // ns from the start of the schedule
+    std::vector<uint64_t> rates_;    // bytes/sec
+};
+
+#endif // RATE_SCHEDULE_H
@@ -0,0 +1,93 @@
+#ifndef ROUND_ROBIN_QUEUE_H
+#define ROUND_ROBIN_QUEUE_H
+
+#include "Packet.h"
+#include "QueueDiscipline.h"
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <memory>
+
+// Packet-by-packet round robin across flows: each backlogged flow sends one
+// packet per round, whatever its priority or packet size. A flow joins the
+// tail of the active list when it becomes backlogged and leaves it when its
+// queue empties, so idle flows hold no state and cost nothing.
+class RoundRobinQueue final : public QueueDiscipline {
+public:
+    RoundRobinQueue(size_t maxSize = 1000)
+        : maxSize_(maxSize)
+        , currentSize_(0)
+        , totalDropped_(0) {}
+
+    // Enqueue a packet (returns false if the queue is full)
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        auto now = std::chrono::high_resolution_clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (currentSize_ >= maxSize_) {
+            totalDropped_++;
+            return false;
+        }
+
+        packet->setEnqueueTime(now);
+        std::deque<std::shared_ptr<Packet>>& queue = flows_[packet->getFlowId()];
+        if (queue.empty()) {
+            active_.push_back(packet->getFlowId());
+        }
+        queue.push_back(std::move(packet));
+        currentSize_++;
+        telemetry_.recordEnqueue(currentSize_, toNanos(now));
+        return true;
+    }
+
+    // Head packet of the next flow in the round
+    std::shared_ptr<Packet> tryDequeue() override {
+        int64_t now = nowNanos();
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (active_.empty()) {
+            telemetry_.recordOccupancy(currentSize_, now);
+            return nullptr;
+        }
+
+        uint32_t flowId = active_.front();
+        active_.pop_front();
+        auto it = flows_.find(flowId);
+        auto packet = std::move(it->second.front());
+        it->second.pop_front();
+        if (it->second.empty()) {
+            flows_.erase(it);
+        } else {
+            active_.push_back(flowId);
+        }
+
+        currentSize_--;
+        telemetry_.recordDequeue(currentSize_, now, now - toNanos(packet->getEnqueueTime()));
+        return packet;
+    }
+
+    size_t size() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return currentSize_;
+    }
+
+    bool empty() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return currentSize_ == 0;
+    }
+
+    size_t getTotalDropped() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return totalDropped_;
+    }
+
+private:
+    std::unordered_map<uint32_t, std::deque<std::shared_ptr<Packet>>> flows_;  // Backlogged only
+    std::deque<uint32_t> active_;   // Backlogged flows in round order
+    size_t maxSize_;
+    size_t currentSize_;
+    size_t totalDropped_;
+    mutable std::mutex mutex_;
+};
+
+#endif // ROUND_ROBIN_QUEUE_H
@@ -0,0 +1,222 @@
+#ifndef SFQ_QUEUE_H
+#define SFQ_QUEUE_H
+
+#include "QueueDiscipline.h"
+#include "PacketSlotPool.h"
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <cstdint>
+
+// Stochastic Fairness Queueing (McKenney), as in Linux sfq: flows are
+// hashed into a fixed number of buckets that are served round robin, a
+// quantum of bytes per turn. Flows that collide in a bucket share its turn,
+// so the hash is re-seeded every perturbation period and queued packets are
+// rehashed, spreading any unlucky collision over time. Each bucket holds at
+// most depthLimit packets.
+//
+// There is no per-flow state: memory is the bucket array plus the packet
+// buffer, whatever the number of flows.
+class SfqQueue final : public QueueDiscipline {
+public:
+    static constexpr uint32_t kMtu = 1514;
+
+    SfqQueue(size_t maxSize = 1000,
+             size_t numBuckets = 1024,
+             uint32_t depthLimit = 127,
+             std::chrono::milliseconds perturbPeriod = std::chrono::seconds(10),
+             uint32_t quantum = kMtu)
+        : pool_(maxSize)
+        , buckets_(numBuckets > 0 ? numBuckets : 1)
+        , activeHead_(PacketSlotPool::kNil)
+        , activeTail_(PacketSlotPool::kNil)
+        , depthLimit_(depthLimit > 0 ? depthLimit : 1)
+        , quantum_(quantum > 0 ? quantum : 1)
+        , perturbPeriod_(std::chrono::duration_cast<std::chrono::nanoseconds>(
+              perturbPeriod).count())
+        , nextPerturb_(0)
+        , rng_(std::random_device{}())
+        , hashSeed_(rng_())
+        , totalDropped_(0) {}
+
+    // Tail drop when the bucket is at its depth limit or the buffer is full
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        auto now = std::chrono::high_resolution_clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        int64_t nowNs = toNanos(now);
+        if (perturbPeriod_ > 0 && nowNs >= nextPerturb_) {
+            if (nextPerturb_ != 0) {
+                perturbLocked();
+            }
+            nextPerturb_ = nowNs + perturbPeriod_;
+        }
+
+        uint32_t index = bucketFor(packet->getFlowId());
+        if (pool_.full() || buckets_[index].packets.packets >= depthLimit_) {
+            totalDropped_++;
+            return false;
+        }
+
+        packet->setEnqueueTime(now);
+        push(index, std::move(packet));
+        telemetry_.recordEnqueue(pool_.used(), nowNs);
+        return true;
+    }
+
+    std::shared_ptr<Packet> tryDequeue() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = nowNanos();
+
+        auto packet = dequeueLocked();
+        if (packet) {
+            telemetry_.recordDequeue(pool_.used(), now,
+                                     now - toNanos(packet->getEnqueueTime()));
+        } else {
+            telemetry_.recordOccupancy(pool_.used(), now);
+        }
+        return packet;
+    }
+
+    // Re-seed the hash now and move queued packets to their new buckets,
+    // keeping each flow's order
+    void perturb() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        perturbLocked();
+    }
+
+    size_t size() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used();
+    }
+
+    bool empty() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used() == 0;
+    }
+
+    size_t getTotalDropped() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return totalDropped_;
+    }
+
+    size_t getNumBuckets() const { return buckets_.size(); }
+
+private:
+    struct Bucket {
+        PacketSlotPool::List packets;
+        int64_t deficit = 0;
+        uint32_t nextActive = PacketSlotPool::kNil;
+        bool active = false;
+    };
+
+    uint32_t bucketFor(uint32_t flowId) const {
+        // Murmur3 finalizer, so a new seed reshuffles which flows collide
+        uint32_t hash = flowId ^ hashSeed_;
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+        return static_cast<uint32_t>((static_cast<uint64_t>(hash) * buckets_.size()) >> 32);
+    }
+
+    void push(uint32_t index, std::shared_ptr<Packet> packet) {
+        Bucket& bucket = buckets_[index];
+        pool_.push(bucket.packets, std::move(packet));
+        if (!bucket.active) {
+            bucket.deficit = quantum_;
+            pushBack(index);
+        }
+    }
+
+    // DRR over the active buckets
+    std::shared_ptr<Packet> dequeueLocked() {
+        while (activeHead_ != PacketSlotPool::kNil) {
+            uint32_t index = activeHead_;
+            Bucket& bucket = buckets_[index];
+
+            if (bucket.deficit <= 0) {
+                bucket.deficit += quantum_;
+                popFront();
+                pushBack(index);
+                continue;
+            }
+
+            auto packet = pool_.pop(bucket.packets);
+            bucket.deficit -= packet->getSize();
+            if (bucket.packets.empty()) {
+                popFront();
+                bucket.active = false;
+            }
+            return packet;
+        }
+        return nullptr;
+    }
+
+    // Packets leave in active-list order and each bucket's packets in FIFO
+    // order, so packets of one flow keep their relative order
+    void perturbLocked() {
+        hashSeed_ = rng_();
+        std::vector<std::shared_ptr<Packet>> queued;
+        queued.reserve(pool_.used());
+        while (activeHead_ != PacketSlotPool::kNil) {
+            uint32_t index = activeHead_;
+            Bucket& bucket = buckets_[index];
+            while (!bucket.packets.empty()) {
+                queued.push_back(pool_.pop(bucket.packets));
+            }
+            popFront();
+            bucket.active = false;
+        }
+        for (auto& packet : queued) {
+            uint32_t index = bucketFor(packet->getFlowId());
+            if (buckets_[index].packets.packets >= depthLimit_) {
+                // The new bucket is over its limit: shed like an overflow
+                packet->markDropped();
+                totalDropped_++;
+                notifyDrop(*packet);
+                continue;
+            }
+            push(index, std::move(packet));
+        }
+    }
+
+    void pushBack(uint32_t index) {
+        Bucket& bucket = buckets_[index];
+        bucket.nextActive = PacketSlotPool::kNil;
+        bucket.active = true;
+        if (activeHead_ == PacketSlotPool::kNil) {
+            activeHead_ = index;
+        } else {
+            buckets_[activeTail_].nextActive = index;
+        }
+        activeTail_ = index;
+    }
+
+    void popFront() {
+        uint32_t index = activeHead_;
+        activeHead_ = buckets_[index].nextActive;
+        if (activeHead_ == PacketSlotPool::kNil) {
+            activeTail_ = PacketSlotPool::kNil;
+        }
+        buckets_[index].nextActive = PacketSlotPool::kNil;
+    }
+
+    PacketSlotPool pool_;
+    std::vector<Bucket> buckets_;
+    uint32_t activeHead_;     // Backlogged buckets, in round order
+    uint32_t activeTail_;
+    uint32_t depthLimit_;     // Packets per bucket
+    uint32_t quantum_;
+    int64_t perturbPeriod_;   // ns, 0 to never perturb
+    int64_t nextPerturb_;     // ns, 0 until the first enqueue
+    std::mt19937 rng_;
+    uint32_t hashSeed_;
+
+    size_t totalDropped_;
+    mutable std::mutex mutex_;
+};
+
+#endif // SFQ_QUEUE_H
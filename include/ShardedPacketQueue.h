@@ -0,0 +1,203 @@
+#ifndef SHARDED_PACKET_QUEUE_H
+#define SHARDED_PACKET_QUEUE_H
+
+#include "QueueDiscipline.h"
+#include "PacketQueue.h"
+#include <queue>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+// Priority queue split into per-thread shards for configurations with
+// several producers and several shaper workers on one logical queue.
+//
+// Each thread is bound to a shard on first use (thread ids are spread
+// round-robin over the shards, standing in for per-core placement).
+// Producers enqueue into their own shard, and a worker dequeues from its
+// own shard without looking at the others. Each shard publishes the
+// priority and creation time of its head packet. When its shard is empty,
+// and on every kLocalRun-th dequeue, a worker instead scans these hints and
+// pops from the shard whose head PacketComparator would send first
+// (highest priority, then earliest creation). Idle workers steal this way,
+// and no shard's traffic can be starved by a busy one.
+//
+// Guarantees relative to PacketQueue:
+// - Capacity and drop accounting are exact: a global atomic counter is
+//   reserved before a packet is inserted.
+// - Priority and FIFO order hold within a shard. Across shards, a head
+//   that should go first is overtaken by at most kLocalRun - 1 packets from
+//   each busy worker's own shard before that worker scans again. The hints
+//   are read without locks, so a scan can also miss a head published or
+//   replaced while it ran.
+// - Packets of one flow stay ordered because a flow is produced by a
+//   single thread into a single shard.
+class ShardedPacketQueue final : public QueueDiscipline {
+public:
+    ShardedPacketQueue(size_t maxSize = 1000, size_t numShards = 0)
+        : shards_(numShards > 0 ? numShards : defaultShardCount())
+        , maxSize_(maxSize)
+        , currentSize_(0)
+        , totalDropped_(0) {}
+
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        if (currentSize_.fetch_add(1) >= maxSize_) {
+            currentSize_.fetch_sub(1);
+            totalDropped_++;
+            return false;  // Queue full, packet dropped
+        }
+
+        Shard& shard = shards_[localShard()];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto now = std::chrono::high_resolution_clock::now();
+        packet->setEnqueueTime(now);
+        shard.queue.push(std::move(packet));
+        shard.telemetry.recordEnqueue(shard.queue.size(), toNanos(now));
+        publishHead(shard);
+        return true;
+    }
+
+    std::shared_ptr<Packet> tryDequeue() override {
+        if (currentSize_.load(std::memory_order_acquire) == 0) {
+            return nullptr;
+        }
+
+        // Own shard first; its lock and hints stay on this core's cache lines
+        size_t own = localShard();
+        Shard& local = shards_[own];
+        if (local.run.fetch_add(1, std::memory_order_relaxed) % kLocalRun != kLocalRun - 1 &&
+            local.topPriority.load(std::memory_order_acquire) != kEmpty) {
+            if (auto packet = popFrom(local)) {
+                return packet;
+            }
+        }
+
+        // Steal, or recheck the others: the shard whose head goes first,
+        // highest priority then earliest creation, as in PacketComparator
+        size_t best = own;
+        int bestPriority = kEmpty;
+        int64_t bestTime = INT64_MAX;
+        for (size_t i = 0; i < shards_.size(); i++) {
+            size_t index = (own + i) % shards_.size();
+            int priority = shards_[index].topPriority.load(std::memory_order_acquire);
+            if (priority < bestPriority || priority == kEmpty) {
+                continue;
+            }
+            int64_t time = shards_[index].headTime.load(std::memory_order_relaxed);
+            if (priority > bestPriority || time < bestTime) {
+                best = index;
+                bestPriority = priority;
+                bestTime = time;
+            }
+        }
+
+        if (bestPriority < 0) {
+            return nullptr;
+        }
+        if (auto packet = popFrom(shards_[best])) {
+            return packet;
+        }
+
+        // Lost a race for that shard; take anything that is left
+        for (size_t i = 0; i < shards_.size(); i++) {
+            if (auto packet = popFrom(shards_[(own + i) % shards_.size()])) {
+                return packet;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t size() const override {
+        return currentSize_.load();
+    }
+
+    bool empty() const override {
+        return currentSize_.load() == 0;
+    }
+
+    size_t getTotalDropped() const override {
+        return totalDropped_.load();
+    }
+
+    // Per-shard telemetry merged: the average occupancy is exact, the high
+    // watermark is the sum of per-shard peaks and so an upper bound
+    QueueTelemetrySnapshot readTelemetry() override {
+        int64_t now = nowNanos();
+        QueueTelemetrySnapshot merged;
+        for (auto& shard : shards_) {
+            merged.add(shard.telemetry.readAndReset(now));
+        }
+        return merged;
+    }
+
+    size_t getNumShards() const { return shards_.size(); }
+
+private:
+    static constexpr int kEmpty = -1;
+    static constexpr uint32_t kLocalRun = 8;   // Dequeues per scan of all shards
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::priority_queue<std::shared_ptr<Packet>,
+                            std::vector<std::shared_ptr<Packet>>,
+                            PacketComparator> queue;
+        // Priority and creation time (ns) of the shard's head packet,
+        // readable without the lock
+        std::atomic<int> topPriority{kEmpty};
+        std::atomic<int64_t> headTime{INT64_MAX};
+        std::atomic<uint32_t> run{0};   // Dequeues by this shard's workers
+        QueueTelemetry telemetry;
+    };
+
+    static size_t defaultShardCount() {
+        unsigned cores = std::thread::hardware_concurrency();
+        return cores > 0 ? cores : 1;
+    }
+
+    // Stable per-thread index, assigned on first use
+    static size_t threadIndex() {
+        static std::atomic<size_t> nextIndex{0};
+        thread_local size_t index = nextIndex.fetch_add(1);
+        return index;
+    }
+
+    size_t localShard() const {
+        return threadIndex() % shards_.size();
+    }
+
+    std::shared_ptr<Packet> popFrom(Shard& shard) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.queue.empty()) {
+            return nullptr;
+        }
+
+        auto packet = shard.queue.top();
+        shard.queue.pop();
+        int64_t now = nowNanos();
+        shard.telemetry.recordDequeue(shard.queue.size(), now,
+                                      now - toNanos(packet->getEnqueueTime()));
+        publishHead(shard);
+        currentSize_.fetch_sub(1, std::memory_order_release);
+        return packet;
+    }
+
+    // Refresh the head hints; called with the shard locked
+    static void publishHead(Shard& shard) {
+        if (shard.queue.empty()) {
+            shard.topPriority.store(kEmpty, std::memory_order_release);
+            return;
+        }
+        const Packet& head = *shard.queue.top();
+        shard.headTime.store(toNanos(head.getCreationTime()), std::memory_order_relaxed);
+        shard.topPriority.store(static_cast<int>(head.getPriority()), std::memory_order_release);
+    }
+
+    std::vector<Shard> shards_;
+    size_t maxSize_;
+    std::atomic<size_t> currentSize_;
+    std::atomic<size_t> totalDropped_;
+};
+
+#endif // SHARDED_PACKET_QUEUE_H
@@ -0,0 +1,160 @@
+#ifndef SHARDED_TOKEN_BUCKET_H
+#define SHARDED_TOKEN_BUCKET_H
+
+#include "RateLimiter.h"
+#include "TatBucket.h"
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+
+// Token bucket shared by many threads without a global serialization
+// point. The bucket itself is a lock-free TatBucket; each thread is bound to
+// a shard (round-robin on first use, as in ShardedPacketQueue) holding a
+// local cache of tokens on its own cache line. Packets are paid from the
+// cache, which is topped up from the global bucket a chunk at a time, so the
+// shared word is touched once per chunk rather than once per packet.
+//
+// Cached tokens that sit unused for idleTimeout are reclaimed: a thread that
+// finds the global bucket empty returns idle shards' caches to it before
+// giving up, and a thread can hand back its own cache with release().
+//
+// Accuracy: tokens are conserved, so the long-run rate is exactly the
+// configured rate. Burst: tokens in caches were taken from the bucket
+// earlier, so over any window at most bucketSize + numShards * chunkSize
+// bytes pass, instead of bucketSize. A consume can be refused while up to
+// chunkSize bytes sit idle in other shards for less than idleTimeout.
+class ShardedTokenBucket : public RateLimiter {
+public:
+    ShardedTokenBucket(uint64_t rate, uint64_t bucketSize,
+                       size_t numShards = 0, uint64_t chunkSize = 0,
+                       uint64_t idleTimeoutNanos = 1000000)   // 1ms
+        : global_(rate, bucketSize)
+        , shards_(numShards > 0 ? numShards : defaultShardCount())
+        , chunkSize_(chunkSize > 0 ? chunkSize : defaultChunkSize(bucketSize, shards_.size()))
+        , idleTimeout_(idleTimeoutNanos) {}
+
+    bool consumeAt(uint32_t tokens, uint64_t nowNs) override {
+        Shard& shard = shards_[localShard()];
+        shard.lastUse.store(nowNs, std::memory_order_relaxed);
+        if (takeLocal(shard, tokens)) {
+            return true;
+        }
+
+        // Top up the cache: a full chunk if the bucket has it, else just the
+        // shortfall, else after reclaiming idle caches
+        uint64_t local = shard.tokens.load(std::memory_order_relaxed);
+        uint32_t shortfall = static_cast<uint32_t>(tokens - std::min<uint64_t>(local, tokens));
+        uint32_t chunk = static_cast<uint32_t>(std::max<uint64_t>(chunkSize_, shortfall));
+        if (global_.consumeAt(chunk, nowNs)) {
+            shard.tokens.fetch_add(chunk, std::memory_order_relaxed);
+        } else if (global_.consumeAt(shortfall, nowNs) ||
+                   (reclaimIdle(shard, nowNs) && global_.consumeAt(shortfall, nowNs))) {
+            shard.tokens.fetch_add(shortfall, std::memory_order_relaxed);
+        } else {
+            return false;
+        }
+        return takeLocal(shard, tokens);
+    }
+
+    uint64_t nanosUntilAvailableAt(uint32_t tokens, uint64_t nowNs) override {
+        uint64_t local = shards_[localShard()].tokens.load(std::memory_order_relaxed);
+        if (local >= tokens) {
+            return 0;
+        }
+        return global_.nanosUntilAt(static_cast<uint32_t>(tokens - local), nowNs);
+    }
+
+    // Tokens in the global bucket plus all caches
+    uint64_t getTokensAt(uint64_t nowNs) override {
+        uint64_t total = global_.tokensAt(nowNs);
+        for (const Shard& shard : shards_) {
+            total += shard.tokens.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // Return the calling thread's cached tokens to the global bucket
+    void release() {
+        Shard& shard = shards_[localShard()];
+        returnTokens(shard, RateLimiter::nowNanos());
+    }
+
+    uint64_t getRate() const override { return global_.getRate(); }
+    uint64_t getBucketSize() const override { return global_.getBurst(); }
+    size_t getNumShards() const { return shards_.size(); }
+    uint64_t getChunkSize() const { return chunkSize_; }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> tokens{0};    // Cached bytes
+        std::atomic<uint64_t> lastUse{0};   // ns, caller's timeline
+    };
+
+    static size_t defaultShardCount() {
+        unsigned cores = std::thread::hardware_concurrency();
+        return cores > 0 ? cores : 1;
+    }
+
+    // A quarter of the bucket spread over the shards, but at least one
+    // full-size packet so a chunk always pays for several small ones
+    static uint64_t defaultChunkSize(uint64_t bucketSize, size_t shards) {
+        return std::max<uint64_t>(bucketSize / (4 * shards), 1500);
+    }
+
+    // Stable per-thread index, assigned on first use
+    static size_t threadIndex() {
+        static std::atomic<size_t> nextIndex{0};
+        thread_local size_t index = nextIndex.fetch_add(1);
+        return index;
+    }
+
+    size_t localShard() const {
+        return threadIndex() % shards_.size();
+    }
+
+    // Several threads share a shard when threads outnumber shards
+    static bool takeLocal(Shard& shard, uint32_t tokens) {
+        uint64_t local = shard.tokens.load(std::memory_order_relaxed);
+        while (local >= tokens) {
+            if (shard.tokens.compare_exchange_weak(local, local - tokens,
+                                                   std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void returnTokens(Shard& shard, uint64_t nowNs) {
+        uint64_t cached = shard.tokens.exchange(0, std::memory_order_relaxed);
+        while (cached > 0) {
+            uint32_t part = static_cast<uint32_t>(std::min<uint64_t>(cached, UINT32_MAX));
+            global_.refundAt(part, nowNs);
+            cached -= part;
+        }
+    }
+
+    // Move caches unused for idleTimeout back to the global bucket
+    bool reclaimIdle(const Shard& self, uint64_t nowNs) {
+        bool reclaimed = false;
+        for (Shard& shard : shards_) {
+            if (&shard == &self || shard.tokens.load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+            uint64_t lastUse = shard.lastUse.load(std::memory_order_relaxed);
+            if (nowNs > lastUse && nowNs - lastUse >= idleTimeout_) {
+                returnTokens(shard, nowNs);
+                reclaimed = true;
+            }
+        }
+        return reclaimed;
+    }
+
+    TatBucket global_;
+    std::vector<Shard> shards_;
+    uint64_t chunkSize_;
+    uint64_t idleTimeout_;
+};
+
+#endif // SHARDED_TOKEN_BUCKET_H
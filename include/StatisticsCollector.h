@@ -2,7 +2,7 @@
 #define STATISTICS_COLLECTOR_H
 
 #include "Flow.h"
-#include "PacketQueue.h"
+#include "QueueDiscipline.h"
 #include <vector>
 #include <memory>
 #include <fstream>
@@ -12,12 +12,14 @@
 #include <atomic>
 #include <iomanip>
 #include <iostream>
+#include <algorithm>
 
 struct FlowStats {
     uint32_t flowId;
     uint64_t packetsSent;
     uint64_t packetsDropped;
     uint64_t bytesTransmitted;
+    uint64_t packetsMarked;   // CE-marked packets delivered (ECN)
     double averageDelay;
     double throughput;  // bytes per second
     double dropRate;
@@ -25,7 +27,11 @@ struct FlowStats {
 
 struct SystemStats {
     double timestamp;  // seconds from start
-    size_t queueOccupancy;
+    size_t queueOccupancy;          // Instantaneous, at sample time
+    size_t queueHighWatermark;      // Peak since the previous sample
+    double queueAverageOccupancy;   // Time-weighted mean since the previous sample
+    double sojournP50Micros;
+    double sojournP99Micros;
     uint64_t totalPacketsTransmitted;
     uint64_t totalBytesTransmitted;
     double aggregateThroughput;
@@ -35,7 +41,7 @@ struct SystemStats {
 class StatisticsCollector {
 public:
     StatisticsCollector(const std::vector<std::shared_ptr<Flow>>& flows,
-                       std::shared_ptr<PacketQueue> queue)
+                       std::shared_ptr<QueueDiscipline> queue)
         : flows_(flows)
         , queue_(queue)
         , running_(false)
@@ -80,11 +86,13 @@ public:
         }
 
         // Write header
-        file << "Timestamp,QueueOccupancy,TotalPackets,TotalBytes,AggregateThroughput";
+        file << "Timestamp,QueueOccupancy,QueueHighWatermark,QueueAvgOccupancy,"
+             << "SojournP50us,SojournP99us,TotalPackets,TotalBytes,AggregateThroughput";
         for (const auto& flow : flows_) {
             file << ",Flow" << flow->getFlowId() << "_Throughput"
                  << ",Flow" << flow->getFlowId() << "_Delay"
-                 << ",Flow" << flow->getFlowId() << "_DropRate";
+                 << ",Flow" << flow->getFlowId() << "_DropRate"
+                 << ",Flow" << flow->getFlowId() << "_Marked";
         }
         file << "\n";
 
@@ -92,6 +100,10 @@ public:
         for (const auto& stats : history_) {
             file << std::fixed << std::setprecision(3) << stats.timestamp << ","
                  << stats.queueOccupancy << ","
+                 << stats.queueHighWatermark << ","
+                 << stats.queueAverageOccupancy << ","
+                 << stats.sojournP50Micros << ","
+                 << stats.sojournP99Micros << ","
                  << stats.totalPacketsTransmitted << ","
                  << stats.totalBytesTransmitted << ","
                  << stats.aggregateThroughput;
@@ -99,7 +111,8 @@ public:
             for (const auto& flowStat : stats.flowStats) {
                 file << "," << flowStat.throughput
                      << "," << flowStat.averageDelay
-                     << "," << flowStat.dropRate;
+                     << "," << flowStat.dropRate
+                     << "," << flowStat.packetsMarked;
             }
             file << "\n";
         }
@@ -120,16 +133,26 @@ public:
         std::cout << "Total Packets Transmitted: " << lastStats.totalPacketsTransmitted << "\n";
         std::cout << "Total Bytes Transmitted: " << lastStats.totalBytesTransmitted << "\n";
         std::cout << "Average Aggregate Throughput: " 
-                  << (lastStats.aggregateThroughput / 1024.0) << " KB/s\n\n";
+                  << (lastStats.aggregateThroughput / 1024.0) << " KB/s\n";
+
+        size_t peakOccupancy = 0;
+        double sojournP99 = 0.0;
+        for (const auto& stats : history_) {
+            peakOccupancy = std::max(peakOccupancy, stats.queueHighWatermark);
+            sojournP99 = std::max(sojournP99, stats.sojournP99Micros);
+        }
+        std::cout << "Peak Queue Occupancy: " << peakOccupancy << " packets\n";
+        std::cout << "Worst Sample P99 Sojourn: " << (sojournP99 / 1000.0) << " ms\n\n";
 
         std::cout << "Per-Flow Statistics:\n";
         std::cout << std::setw(8) << "FlowID" 
                   << std::setw(12) << "Sent"
                   << std::setw(12) << "Dropped"
                   << std::setw(12) << "DropRate%"
+                  << std::setw(10) << "Marked"
                   << std::setw(15) << "Throughput(KB/s)"
                   << std::setw(15) << "AvgDelay(ms)\n";
-        std::cout << std::string(74, '-') << "\n";
+        std::cout << std::string(84, '-') << "\n";
 
         for (const auto& flowStat : lastStats.flowStats) {
             std::cout << std::setw(8) << flowStat.flowId
@@ -137,11 +160,23 @@ public:
                       << std::setw(12) << flowStat.packetsDropped
                       << std::setw(12) << std::fixed << std::setprecision(2) 
                       << (flowStat.dropRate * 100.0)
+                      << std::setw(10) << flowStat.packetsMarked
                       << std::setw(15) << std::fixed << std::setprecision(2)
                       << (flowStat.throughput / 1024.0)
                       << std::setw(15) << std::fixed << std::setprecision(3)
                       << flowStat.averageDelay << "\n";
         }
+
+        // Latency SLAs, for flows that have one
+        for (const auto& flow : flows_) {
+            if (flow->getLatencyBudget().count() > 0) {
+                std::cout << "  Flow " << flow->getFlowId() << ": "
+                          << flow->getDeadlineMisses() << " packets over its "
+                          << std::defaultfloat << std::setprecision(6)
+                          << (flow->getLatencyBudget().count() / 1000.0)
+                          << " ms budget\n";
+            }
+        }
         std::cout << "========================================\n\n";
     }
 
@@ -154,6 +189,14 @@ private:
             SystemStats stats;
             stats.timestamp = elapsed;
             stats.queueOccupancy = queue_->size();
+
+            // Lock-free counters kept by the queue itself catch bursts that
+            // fall between samples
+            QueueTelemetrySnapshot telemetry = queue_->readTelemetry();
+            stats.queueHighWatermark = telemetry.highWatermark;
+            stats.queueAverageOccupancy = telemetry.averageOccupancy;
+            stats.sojournP50Micros = telemetry.sojournPercentileMicros(0.50);
+            stats.sojournP99Micros = telemetry.sojournPercentileMicros(0.99);
             
             // Collect per-flow statistics
             uint64_t totalBytes = 0;
@@ -165,6 +208,7 @@ private:
                 flowStat.packetsSent = flow->getPacketsSent();
                 flowStat.packetsDropped = flow->getPacketsDropped();
                 flowStat.bytesTransmitted = flow->getBytesTransmitted();
+                flowStat.packetsMarked = flow->getPacketsMarked();
                 flowStat.averageDelay = flow->getAverageDelay();
                 
                 // Calculate throughput over sample interval
@@ -192,7 +236,7 @@ private:
     }
 
     std::vector<std::shared_ptr<Flow>> flows_;
-    std::shared_ptr<PacketQueue> queue_;
+    std::shared_ptr<QueueDiscipline> queue_;
     std::atomic<bool> running_;
     std::chrono::high_resolution_clock::time_point startTime_;
     uint32_t sampleInterval_;
@@ -0,0 +1,146 @@
+#ifndef TAT_BUCKET_H
+#define TAT_BUCKET_H
+
+#include "FixedPoint.h"
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+// Lock-free token bucket kept as a single theoretical arrival time (TAT),
+// the GCRA / virtual scheduling form: the bucket is full at or after TAT,
+// and each conforming packet pushes TAT forward by its transmission time at
+// the configured rate. There is no refill step and no token counter, so an
+// update is one load and one compare-and-swap.
+//
+// Times are in 1/256 ns and wrap modulo 2^64; they are only ever compared by
+// signed difference, which stays correct for idle gaps up to ~400 days.
+// Callers pass nanoseconds on a single timeline of their choosing.
+class TatBucket {
+public:
+    // Starts full unless 'initial' bytes (at most 'burst') are given
+    TatBucket(uint64_t rate, uint64_t burst, uint64_t initial = UINT64_MAX)
+        : rate_(rate > 0 ? rate : 1)
+        , burst_(burst)
+        , cost_(FixedPoint::scaledRatio(1000000000ULL, rate_, kCostShift))
+        , tolerance_(static_cast<int64_t>(costOf(burst_)))
+        , initialDebt_(costOf(burst_ - std::min(initial, burst_)))
+        , tat_(0)
+        , started_(false) {}
+
+    // Debit 'bytes' if the bucket holds at least 'bytes' plus 'reserve'
+    // (reserve is in the units returned by creditAt)
+    bool consumeAt(uint32_t bytes, uint64_t nowNs, int64_t reserve = 0) {
+        uint64_t now = toUnits(nowNs);
+        uint64_t cost = costOf(bytes);
+        int64_t limit = tolerance_ - reserve - static_cast<int64_t>(cost);
+        uint64_t tat = loadTat(now);
+        while (true) {
+            uint64_t base = later(tat, now);
+            if (static_cast<int64_t>(base - now) > limit) {
+                return false;
+            }
+            if (tat_.compare_exchange_weak(tat, base + cost,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_acquire)) {
+                return true;
+            }
+        }
+    }
+
+    // Debit 'bytes' whether or not the bucket holds them
+    void forceConsumeAt(uint32_t bytes, uint64_t nowNs) {
+        uint64_t now = toUnits(nowNs);
+        uint64_t tat = loadTat(now);
+        while (!tat_.compare_exchange_weak(tat, later(tat, now) + costOf(bytes),
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_acquire)) {
+        }
+    }
+
+    // Return 'bytes' of unused credit; anything beyond a full bucket is lost
+    void refundAt(uint32_t bytes, uint64_t nowNs) {
+        uint64_t now = toUnits(nowNs);
+        uint64_t cost = costOf(bytes);
+        uint64_t tat = loadTat(now);
+        while (static_cast<int64_t>(tat - now) > 0 &&
+               !tat_.compare_exchange_weak(tat, later(tat - cost, now),
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_acquire)) {
+        }
+    }
+
+    // Credit held at nowNs, in 1/256 ns of transmission time at the rate;
+    // negative while in debt. Comparable between buckets of the same rate.
+    int64_t creditAt(uint64_t nowNs) const {
+        uint64_t now = toUnits(nowNs);
+        uint64_t tat = tat_.load(std::memory_order_acquire);
+        if (!started_.load(std::memory_order_relaxed)) {
+            return tolerance_ - static_cast<int64_t>(initialDebt_);
+        }
+        return tolerance_ - static_cast<int64_t>(later(tat, now) - now);
+    }
+
+    // Bytes available at nowNs
+    uint64_t tokensAt(uint64_t nowNs) const {
+        int64_t credit = creditAt(nowNs);
+        if (credit <= 0) {
+            return 0;
+        }
+        return std::min<uint64_t>(static_cast<uint64_t>(
+            (static_cast<long double>(credit) * (1ULL << kCostShift)) /
+            (static_cast<long double>(cost_) * (1ULL << kTimeShift))), burst_);
+    }
+
+    // Nanoseconds until 'bytes' could be consumed, 0 if they can now
+    uint64_t nanosUntilAt(uint32_t bytes, uint64_t nowNs) const {
+        int64_t shortfall = static_cast<int64_t>(costOf(bytes)) - creditAt(nowNs);
+        if (shortfall <= 0) {
+            return 0;
+        }
+        return (static_cast<uint64_t>(shortfall) >> kTimeShift) + 1;
+    }
+
+    uint64_t getRate() const { return rate_; }
+    uint64_t getBurst() const { return burst_; }
+
+private:
+    static constexpr unsigned kTimeShift = 8;    // Fraction bits of a nanosecond
+    static constexpr unsigned kCostShift = 32;   // Fraction bits of cost_
+
+    static uint64_t toUnits(uint64_t nowNs) { return nowNs << kTimeShift; }
+
+    // The later of two wrapping times
+    static uint64_t later(uint64_t a, uint64_t b) {
+        return static_cast<int64_t>(a - b) > 0 ? a : b;
+    }
+
+    // Transmission time of 'bytes' at the rate, in 1/256 ns, rounded to
+    // nearest so that short packets at high rates carry no systematic bias
+    uint64_t costOf(uint64_t bytes) const {
+        uint64_t half = 1ULL << (kCostShift - kTimeShift - 1);
+        return FixedPoint::mulShrCarry(bytes, cost_, kCostShift - kTimeShift, half);
+    }
+
+    // TAT starts "now" on the first call, i.e. with a full bucket, or
+    // later by the initial shortfall
+    uint64_t loadTat(uint64_t now) {
+        if (started_.load(std::memory_order_relaxed)) {
+            return tat_.load(std::memory_order_acquire);
+        }
+        uint64_t zero = 0;
+        tat_.compare_exchange_strong(zero, now + initialDebt_, std::memory_order_acq_rel);
+        started_.store(true, std::memory_order_release);
+        return tat_.load(std::memory_order_acquire);
+    }
+
+    uint64_t rate_;         // bytes/sec
+    uint64_t burst_;        // bytes
+    uint64_t cost_;         // ns per byte, scaled by 2^kCostShift
+    int64_t tolerance_;     // Burst in time units (GCRA tau)
+    uint64_t initialDebt_;  // Time units the first TAT lies ahead of "now"
+
+    alignas(64) std::atomic<uint64_t> tat_;
+    std::atomic<bool> started_;
+};
+
+#endif // TAT_BUCKET_H
@@ -0,0 +1,175 @@
+#ifndef TIMING_WHEEL_QUEUE_H
+#define TIMING_WHEEL_QUEUE_H
+
+#include "QueueDiscipline.h"
+#include "PacketSlotPool.h"
+#include "FixedPoint.h"
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+// Per-flow pacing on a timing wheel, as in Carousel (Saeed et al., SIGCOMM
+// 2017). On enqueue each packet is stamped with its departure time: the
+// later of now and the time its flow's previous packet finishes at the
+// flow's rate. It then goes into the wheel slot covering that time. Dequeue
+// walks the slots in time order and releases a slot's packets once its time
+// has come. Enqueue and dequeue are O(1), amortised over the slots walked,
+// with no heap and no token bucket, so a shaper over this discipline runs
+// without a rate limiter.
+//
+// The wheel spans numSlots * granularity (the horizon). A packet whose
+// departure lies beyond it is dropped: its flow already has a horizon's
+// worth of traffic queued. Flows without a rate are not paced.
+class TimingWheelQueue final : public QueueDiscipline {
+public:
+    TimingWheelQueue(size_t maxSize = 1000,
+                     std::chrono::microseconds granularity = std::chrono::microseconds(100),
+                     size_t numSlots = 16384)
+        : pool_(maxSize)
+        , wheel_(numSlots > 0 ? numSlots : 1)
+        , granularity_(std::max<int64_t>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(granularity).count(), 1))
+        , cursor_(0)
+        , totalDropped_(0)
+        , horizonDrops_(0) {}
+
+    // Pace the flow at 'rate' bytes/sec (0: send as soon as queued)
+    void setRate(uint32_t flowId, uint64_t rate) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        FlowState& flow = flows_[slotFor(flowId)];
+        flow.cost = rate > 0 ? FixedPoint::scaledRatio(1000000000ULL, rate, kCostShift) : 0;
+        flow.carry = 0;
+    }
+
+    // Tail drop when the buffer is full or the departure is past the horizon
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        auto now = std::chrono::high_resolution_clock::now();
+        packet->setEnqueueTime(now);
+        return enqueueAt(std::move(packet), toNanos(now));
+    }
+
+    std::shared_ptr<Packet> tryDequeue() override {
+        return tryDequeueAt(nowNanos());
+    }
+
+    // enqueue/tryDequeue on a caller-supplied timeline (ns), for simulation
+    bool enqueueAt(std::shared_ptr<Packet> packet, int64_t nowNs) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (pool_.full()) {
+            totalDropped_++;
+            return false;
+        }
+        if (pool_.used() == 0) {
+            cursor_ = std::max(cursor_, nowNs / granularity_);
+        }
+
+        FlowState& flow = flows_[slotFor(packet->getFlowId())];
+        int64_t departure = std::max(nowNs, flow.nextDeparture);
+        int64_t slot = std::max(departure / granularity_, cursor_);
+        if (slot - cursor_ >= static_cast<int64_t>(wheel_.size())) {
+            totalDropped_++;
+            horizonDrops_++;
+            return false;
+        }
+        if (flow.cost > 0) {
+            flow.nextDeparture = departure + static_cast<int64_t>(
+                FixedPoint::mulShrCarry(packet->getSize(), flow.cost, kCostShift, flow.carry));
+        }
+
+        pool_.push(wheel_[slot % wheel_.size()], std::move(packet));
+        telemetry_.recordEnqueue(pool_.used(), nowNs);
+        return true;
+    }
+
+    std::shared_ptr<Packet> tryDequeueAt(int64_t nowNs) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        int64_t due = nowNs / granularity_;
+        while (pool_.used() > 0 && cursor_ <= due) {
+            PacketSlotPool::List& slot = wheel_[cursor_ % wheel_.size()];
+            if (!slot.empty()) {
+                auto packet = pool_.pop(slot);
+                telemetry_.recordDequeue(pool_.used(), nowNs,
+                                         nowNs - toNanos(packet->getEnqueueTime()));
+                return packet;
+            }
+            cursor_++;
+        }
+        telemetry_.recordOccupancy(pool_.used(), nowNs);
+        return nullptr;
+    }
+
+    // Start of the slot under the cursor if it holds packets, else of the
+    // next one. Never later than the true next departure, so an idle shaper
+    // wakes at most once per slot.
+    int64_t nextEligibleTime() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pool_.used() == 0) {
+            return kNeverEligible;
+        }
+        bool current = !wheel_[cursor_ % wheel_.size()].empty();
+        return (cursor_ + (current ? 0 : 1)) * granularity_;
+    }
+
+    size_t size() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used();
+    }
+
+    bool empty() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used() == 0;
+    }
+
+    size_t getTotalDropped() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return totalDropped_;
+    }
+
+    // Packets dropped because their departure was beyond the horizon
+    size_t getHorizonDrops() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return horizonDrops_;
+    }
+
+    std::chrono::nanoseconds getHorizon() const {
+        return std::chrono::nanoseconds(granularity_ * static_cast<int64_t>(wheel_.size()));
+    }
+
+private:
+    static constexpr unsigned kCostShift = 32;   // Fraction bits of cost
+
+    struct FlowState {
+        int64_t nextDeparture = 0;  // ns
+        uint64_t cost = 0;          // ns per byte, scaled by 2^kCostShift
+        uint64_t carry = 0;         // Fraction of a ns left over
+    };
+
+    uint32_t slotFor(uint32_t flowId) {
+        auto it = slots_.find(flowId);
+        if (it != slots_.end()) {
+            return it->second;
+        }
+        uint32_t slot = static_cast<uint32_t>(flows_.size());
+        slots_.emplace(flowId, slot);
+        flows_.emplace_back();
+        return slot;
+    }
+
+    PacketSlotPool pool_;
+    std::vector<PacketSlotPool::List> wheel_;
+    std::unordered_map<uint32_t, uint32_t> slots_;  // Flow id -> slot
+    std::vector<FlowState> flows_;
+    int64_t granularity_;   // ns per wheel slot
+    int64_t cursor_;        // Absolute number of the earliest slot not yet drained
+
+    size_t totalDropped_;
+    size_t horizonDrops_;
+    mutable std::mutex mutex_;
+};
+
+#endif // TIMING_WHEEL_QUEUE_H
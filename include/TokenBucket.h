@@ -1,59 +1,307 @@
 #ifndef TOKEN_BUCKET_H
 #define TOKEN_BUCKET_H
 
+#include "RateLimiter.h"
+#include "FixedPoint.h"
+#include "RateSchedule.h"
 #include <chrono>
 #include <mutex>
+#include <memory>
+#include <atomic>
 #include <cstdint>
+#include <algorithm>
+#include <limits>
 
-class TokenBucket {
+// Token bucket with fixed-point credit accounting: tokens are kept in
+// 1/2^20 byte units, time in nanoseconds, and the refill is a single
+// multiply by a precomputed per-nanosecond credit (no division). The low
+// bits of every refill product are carried into the next one, so frequent
+// refills at low rates never discard fractional credit; achieved rate
+// tracks the configured rate from 1 kbps to 400 Gbps.
+//
+// Optional extra buckets are checked and charged together with the byte
+// bucket in one operation: a peak-rate bucket (Linux tbf peakrate/mtu)
+// bounds how fast a full bucket drains, and a packet bucket limits packets
+// per second independently of their size.
+//
+// The byte bucket's rate can follow a RateSchedule. Refill integrates
+// across every segment boundary it passes, so credit is exact however
+// rarely the bucket is used.
+class TokenBucket : public RateLimiter {
 public:
     TokenBucket(uint64_t rate, uint64_t bucketSize)
-        : rate_(rate)                  // Tokens per second (bytes/sec)
-        , bucketSize_(bucketSize)      // Maximum bucket capacity (bytes)
-        , tokens_(bucketSize)          // Start with full bucket
-        , lastUpdate_(std::chrono::high_resolution_clock::now()) {}
+        : baseRate_(rate > 0 ? rate : 1)   // Tokens per second (bytes/sec)
+        , rate_(baseRate_)
+        , peakRate_(0)
+        , peakMtu_(0)
+        , packetRate_(0)
+        , lastUpdate_(kUnset)
+        , scheduleStart_(0)
+        , scheduleIndex_(0)
+        , nextChange_(kUnset) {
+        bytes_.configure(baseRate_, bucketSize);   // Start with full bucket
+    }
+
+    // Take the token rate from 'schedule', whose time 0 is startNs on the
+    // consumeAt() timeline. A null or empty schedule restores the rate
+    // given at construction.
+    void setRateScheduleAt(std::shared_ptr<const RateSchedule> schedule, uint64_t startNs) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        refill(startNs);
+        if (schedule && !schedule->empty()) {
+            schedule_ = schedule;
+            scheduleStart_ = startNs;
+            scheduleIndex_ = 0;
+            enterSegment(lastUpdate_);
+        } else {
+            schedule_.reset();
+            nextChange_ = kUnset;
+            bytes_.setRate(baseRate_);
+            rate_ = baseRate_;
+        }
+    }
+
+    void setRateSchedule(std::shared_ptr<const RateSchedule> schedule) {
+        setRateScheduleAt(schedule, RateLimiter::nowNanos());
+    }
+
+    // Limit the drain rate of a full bucket to peakRate (bytes/sec) with an
+    // mtu-sized second bucket, as tbf does; 0 disables. Packets larger than
+    // mtu never conform, and getMaxPacketSize() reports mtu so that the
+    // shaper drops them, as tbf does, instead of waiting on them.
+    void setPeakRate(uint64_t peakRate, uint32_t mtu) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        peakRate_.store(peakRate, std::memory_order_relaxed);
+        if (peakRate > 0) {
+            peak_.configure(peakRate, mtu);
+            peakMtu_.store(mtu, std::memory_order_relaxed);
+        } else {
+            peak_ = Bucket();
+            peakMtu_.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Also limit packets per second, with a burst of packetBurst packets;
+    // 0 disables. Every consume() counts as one packet.
+    void setPacketRate(uint64_t packetRate, uint64_t packetBurst) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        packetRate_ = packetRate;
+        if (packetRate > 0) {
+            packets_.configure(packetRate, std::max<uint64_t>(packetBurst, 1));
+        } else {
+            packets_ = Bucket();
+        }
+    }
 
     // Try to consume tokens for a packet
-    bool consume(uint32_t tokens) {
+    bool consumeAt(uint32_t tokens, uint64_t nowNs) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        refill(nowNs);
+        return take(tokens);
+    }
+
+    // One lock and one refill for the whole batch. Without a peak rate the
+    // byte sum is checked once; the peak bucket is checked packet by packet,
+    // since it holds only one mtu.
+    uint32_t consumeBatchAt(const uint32_t* sizes, uint32_t count, uint64_t nowNs) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        refill(nowNs);
+
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            total += sizes[i];
+        }
+        uint64_t packets = static_cast<uint64_t>(count) << kTokenShift;
+        if (!peak_.enabled() && bytes_.tokens >= total << kTokenShift &&
+            (!packets_.enabled() || packets_.tokens >= packets)) {
+            bytes_.tokens -= total << kTokenShift;
+            if (packets_.enabled()) {
+                packets_.tokens -= packets;
+            }
+            return count;
+        }
+
+        uint32_t charged = 0;
+        while (charged < count && take(sizes[charged])) {
+            charged++;
+        }
+        return charged;
+    }
+
+    // Time until every bucket holds the packet
+    uint64_t nanosUntilAvailableAt(uint32_t tokens, uint64_t nowNs) override {
         std::lock_guard<std::mutex> lock(mutex_);
-        refill();
-        
-        if (tokens_ >= tokens) {
-            tokens_ -= tokens;
-            return true;
+        refill(nowNs);
+
+        uint64_t needed = static_cast<uint64_t>(tokens) << kTokenShift;
+        uint64_t wait = bytes_.waitFor(needed);
+        if (schedule_) {
+            // Recheck at the next rate change
+            wait = std::min(wait, nextChange_ - std::min(nextChange_, nowNs));
+        }
+        if (peak_.enabled()) {
+            wait = std::max(wait, peak_.waitFor(needed));
         }
-        return false;
+        if (packets_.enabled()) {
+            wait = std::max(wait, packets_.waitFor(kOnePacket));
+        }
+        return wait;
     }
 
     // Get current token count
-    uint64_t getTokens() {
+    uint64_t getTokensAt(uint64_t nowNs) override {
         std::lock_guard<std::mutex> lock(mutex_);
-        refill();
-        return tokens_;
+        refill(nowNs);
+        return bytes_.tokens >> kTokenShift;
     }
 
-    uint64_t getRate() const { return rate_; }
-    uint64_t getBucketSize() const { return bucketSize_; }
+    // Current rate, which follows the schedule if one is set
+    uint64_t getRate() const override { return rate_.load(std::memory_order_relaxed); }
+    uint64_t getBucketSize() const override { return bytes_.size; }
+    uint64_t getMaxPacketSize() const override {
+        uint32_t mtu = peakMtu_.load(std::memory_order_relaxed);
+        return mtu > 0 ? std::min<uint64_t>(mtu, bytes_.size) : bytes_.size;
+    }
+    uint64_t getPeakRate() const { return peakRate_.load(std::memory_order_relaxed); }
+    uint64_t getPacketRate() const { return packetRate_; }
 
 private:
-    void refill() {
-        auto now = std::chrono::high_resolution_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
-            now - lastUpdate_).count();
-        
-        // Calculate tokens to add based on elapsed time
-        uint64_t tokensToAdd = (rate_ * elapsed) / 1000000;
-        
-        if (tokensToAdd > 0) {
-            tokens_ = std::min(tokens_ + tokensToAdd, bucketSize_);
-            lastUpdate_ = now;
-        }
-    }
-
-    uint64_t rate_;           // Token generation rate (bytes/sec)
-    uint64_t bucketSize_;     // Maximum bucket capacity
-    uint64_t tokens_;         // Current token count
-    std::chrono::high_resolution_clock::time_point lastUpdate_;
+    static constexpr unsigned kTokenShift = 20;   // Token fraction bits
+    static constexpr unsigned kCreditShift = 24;  // Extra precision of the rate multiplier
+    static constexpr unsigned kWaitShift = 32;    // Precision of nanosPerToken
+    static constexpr uint64_t kMaxBucketSize = (1ULL << (64 - kTokenShift)) - 1;
+    static constexpr uint64_t kUnset = std::numeric_limits<uint64_t>::max();
+    static constexpr uint64_t kOnePacket = 1ULL << kTokenShift;
+
+    // Fixed-point state of one bucket
+    struct Bucket {
+        uint64_t size = 0;            // Capacity in tokens; 0 when disabled
+        uint64_t creditPerNano = 0;   // rate / 1e9, scaled by 2^(kTokenShift + kCreditShift)
+        uint64_t nanosPerToken = 0;   // 1e9 / rate, scaled by 2^kWaitShift
+        uint64_t fillTimeNanos = 0;   // Time to refill when empty
+        uint64_t tokens = 0;          // Current tokens, scaled by 2^kTokenShift
+        uint64_t carry = 0;           // Sub-unit remainder of previous refills
+
+        bool enabled() const { return size > 0; }
+
+        void configure(uint64_t rate, uint64_t bucketSize) {
+            size = std::min<uint64_t>(bucketSize, kMaxBucketSize);
+            setRate(rate);
+            tokens = size << kTokenShift;
+        }
+
+        // Change the rate, keeping the tokens
+        void setRate(uint64_t rate) {
+            rate = std::max<uint64_t>(rate, 1);
+            creditPerNano = FixedPoint::scaledRatio(rate, 1000000000ULL,
+                                                    kTokenShift + kCreditShift);
+            nanosPerToken = FixedPoint::scaledRatio(1000000000ULL, rate, kWaitShift);
+            long double fill = static_cast<long double>(size) * 1e9L / rate;
+            fillTimeNanos = fill >= static_cast<long double>(kUnset)
+                                ? kUnset : static_cast<uint64_t>(fill) + 1;
+            carry = 0;
+        }
+
+        bool full() const { return tokens == size << kTokenShift; }
+
+        void refill(uint64_t elapsed) {
+            uint64_t full = size << kTokenShift;
+            if (elapsed >= fillTimeNanos) {
+                tokens = full;
+                carry = 0;
+                return;
+            }
+            // elapsed < fill time, so the credit fits comfortably in 64 bits
+            uint64_t credit = FixedPoint::mulShrCarry(elapsed, creditPerNano,
+                                                      kCreditShift, carry);
+            if (credit >= full - tokens) {
+                tokens = full;
+                carry = 0;
+            } else {
+                tokens += credit;
+            }
+        }
+
+        uint64_t waitFor(uint64_t needed) const {
+            if (tokens >= needed) {
+                return 0;
+            }
+            return FixedPoint::mulShr(needed - tokens, nanosPerToken,
+                                      kTokenShift + kWaitShift) + 1;
+        }
+    };
+
+    // Charge one packet to every bucket if they all hold it
+    bool take(uint32_t tokens) {
+        uint64_t needed = static_cast<uint64_t>(tokens) << kTokenShift;
+        if (bytes_.tokens < needed ||
+            (peak_.enabled() && peak_.tokens < needed) ||
+            (packets_.enabled() && packets_.tokens < kOnePacket)) {
+            return false;
+        }
+        bytes_.tokens -= needed;
+        if (peak_.enabled()) {
+            peak_.tokens -= needed;
+        }
+        if (packets_.enabled()) {
+            packets_.tokens -= kOnePacket;
+        }
+        return true;
+    }
+
+    void refill(uint64_t now) {
+        if (lastUpdate_ == kUnset || now <= lastUpdate_) {
+            // First use fixes the timeline; time never runs backwards
+            if (lastUpdate_ == kUnset) lastUpdate_ = now;
+            return;
+        }
+
+        uint64_t elapsed = now - lastUpdate_;
+        uint64_t from = lastUpdate_;
+        lastUpdate_ = now;
+        while (nextChange_ <= now) {
+            // Credit up to the boundary at the old rate, then switch. A full
+            // bucket stays full whatever the rates, so skip straight to now.
+            if (nextChange_ > from) {
+                bytes_.refill(nextChange_ - from);
+                from = nextChange_;
+            }
+            if (bytes_.full()) {
+                from = now;
+            }
+            enterSegment(from);
+        }
+        bytes_.refill(now - from);
+        if (peak_.enabled()) {
+            peak_.refill(elapsed);
+        }
+        if (packets_.enabled()) {
+            packets_.refill(elapsed);
+        }
+    }
+
+    // Switch to the schedule's segment at 'at'
+    void enterSegment(uint64_t at) {
+        RateSchedule::Position position = schedule_->locate(at - scheduleStart_, scheduleIndex_);
+        scheduleIndex_ = position.index;
+        bytes_.setRate(position.rate);
+        rate_ = std::max<uint64_t>(position.rate, 1);
+        nextChange_ = position.untilNext >= kUnset - at ? kUnset : at + position.untilNext;
+    }
+
+    uint64_t baseRate_;       // Rate given at construction (bytes/sec)
+    std::atomic<uint64_t> rate_;  // Current token rate (bytes/sec)
+    std::atomic<uint64_t> peakRate_;  // Peak drain rate (bytes/sec), 0 if unlimited
+    std::atomic<uint32_t> peakMtu_;   // Size of the peak bucket, 0 if unlimited
+    uint64_t packetRate_;     // Packets/sec, 0 if unlimited
+    Bucket bytes_;            // Main bucket
+    Bucket peak_;             // Peak-rate bucket, mtu sized
+    Bucket packets_;          // Packet bucket, tokens are packets
+    uint64_t lastUpdate_;     // Nanoseconds on the caller's timeline
+    std::shared_ptr<const RateSchedule> schedule_;
+    uint64_t scheduleStart_;  // Schedule time 0 on the caller's timeline
+    size_t scheduleIndex_;    // Current segment
+    uint64_t nextChange_;     // Next rate change on the caller's timeline, kUnset if none
     std::mutex mutex_;
 };
 
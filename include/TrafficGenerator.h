@@ -2,16 +2,19 @@
 #define TRAFFIC_GENERATOR_H
 
 #include "Flow.h"
-#include "PacketQueue.h"
+#include "QueueDiscipline.h"
+#include "ColorMarker.h"
+#include "PolicerTable.h"
 #include <thread>
 #include <vector>
 #include <memory>
 #include <chrono>
 #include <atomic>
+#include <unordered_map>
 
 class TrafficGenerator {
 public:
-    TrafficGenerator(std::shared_ptr<PacketQueue> queue)
+    TrafficGenerator(std::shared_ptr<QueueDiscipline> queue)
         : queue_(queue)
         , running_(false) {}
 
@@ -24,12 +27,42 @@ public:
         flows_.push_back(flow);
     }
 
+    // Police all flows at ingress: packets are colored before enqueue and
+    // red ones are dropped. Must be set before start().
+    void setColorMarker(std::shared_ptr<ColorMarker> marker) {
+        marker_ = marker;
+    }
+
+    // Per-flow policing at ingress: packets exceeding their flow's contract
+    // are dropped. The generator runs the table's refill thread while it
+    // runs. Must be set before start().
+    void setPolicer(std::shared_ptr<PolicerTable> policer) {
+        policer_ = policer;
+    }
+
     // Start generating traffic for all flows
     void start() {
         if (running_) return;
         
         running_ = true;
+
+        // Packets discarded after acceptance (AQM, head drops) still count
+        // against their flow. Captures the flows by value because the queue
+        // keeps draining after the generator stops.
+        std::unordered_map<uint32_t, std::shared_ptr<Flow>> flowsById;
+        for (const auto& flow : flows_) {
+            flowsById[flow->getFlowId()] = flow;
+        }
+        queue_->setDropCallback([flowsById](const Packet& packet) {
+            auto it = flowsById.find(packet.getFlowId());
+            if (it != flowsById.end()) {
+                it->second->recordDrop();
+            }
+        });
         
+        if (policer_) {
+            policer_->start();
+        }
         for (auto& flow : flows_) {
             threads_.emplace_back(&TrafficGenerator::generateTraffic, this, flow);
         }
@@ -52,6 +85,10 @@ public:
         }
         
         threads_.clear();
+
+        if (policer_) {
+            policer_->stop();
+        }
     }
 
     const std::vector<std::shared_ptr<Flow>>& getFlows() const {
@@ -64,8 +101,11 @@ private:
             // Generate a packet
             auto packet = std::make_shared<Packet>(flow->generatePacket());
             
-            // Try to enqueue the packet
-            if (!queue_->enqueue(packet)) {
+            if ((marker_ && marker_->mark(*packet) == PacketColor::RED) ||
+                (policer_ && !policer_->conform(packet->getFlowId(), packet->getSize()))) {
+                // Out of contract: policed at ingress
+                flow->recordDrop();
+            } else if (!queue_->enqueue(packet)) {
                 // Packet was dropped due to queue overflow
                 flow->recordDrop();
             }
@@ -76,7 +116,9 @@ private:
         }
     }
 
-    std::shared_ptr<PacketQueue> queue_;
+    std::shared_ptr<QueueDiscipline> queue_;
+    std::shared_ptr<ColorMarker> marker_;
+    std::shared_ptr<PolicerTable> policer_;
     std::vector<std::shared_ptr<Flow>> flows_;
     std::vector<std::thread> threads_;
     std::atomic<bool> running_;
@@ -1,30 +1,67 @@
 #ifndef TRAFFIC_SHAPER_H
 #define TRAFFIC_SHAPER_H
 
-#include "TokenBucket.h"
-#include "PacketQueue.h"
+#include "RateLimiter.h"
+#include "QueueDiscipline.h"
 #include "Packet.h"
 #include "Flow.h"
+#include "Link.h"
 #include <thread>
 #include <atomic>
 #include <memory>
 #include <chrono>
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
+#include <cstdint>
 
-class TrafficShaper {
+// Serves packets from a queue discipline through a rate limiter onto a link.
+// The discipline decides which packet goes next; the shaper only waits for
+// tokens and for the discipline's next eligible time.
+//
+// The rate limiter may be null when the discipline paces packets itself
+// (TimingWheelQueue); packets then go out as soon as they are dequeued.
+// Packets larger than the limiter's getMaxPacketSize() can never conform;
+// they are dropped and counted against their flow, as tbf drops them,
+// rather than blocking the head of the queue.
+//
+// Packets are serialized on a Link. Shapers given the same Link share one
+// wire and take turns on it; a shaper built from a capacity has its own.
+//
+// With a batch size above one the shaper dequeues up to that many packets
+// at a time, but no more than the limiter's tokens on hand cover plus one,
+// and pays for them with one consumeBatch(), sleeps once for their
+// combined transmission time and updates each flow's statistics once per
+// batch. Packets are stamped with their own departure times, spaced by
+// their serialization times from the start of the batch, so per-packet
+// delays stay accurate while clock reads, limiter locks and sleeps are paid
+// per batch. Packets dequeued but unsent when the shaper stops are counted
+// as dropped.
+//
+// Queue is QueueDiscipline for run-time selection (TrafficShaper), or a
+// concrete final discipline so that its enqueue/dequeue calls are resolved
+// statically and inline into the loop.
+template <typename Queue>
+class BasicTrafficShaper {
 public:
-    TrafficShaper(std::shared_ptr<PacketQueue> inputQueue,
-                  std::shared_ptr<TokenBucket> tokenBucket,
+    BasicTrafficShaper(std::shared_ptr<Queue> inputQueue,
+                  std::shared_ptr<RateLimiter> rateLimiter,
                   uint64_t linkCapacity)  // bits per second
+        : BasicTrafficShaper(inputQueue, rateLimiter, std::make_shared<Link>(linkCapacity)) {}
+
+    BasicTrafficShaper(std::shared_ptr<Queue> inputQueue,
+                  std::shared_ptr<RateLimiter> rateLimiter,
+                  std::shared_ptr<Link> link)
         : inputQueue_(inputQueue)
-        , tokenBucket_(tokenBucket)
-        , linkCapacity_(linkCapacity)
+        , rateLimiter_(rateLimiter)
+        , link_(link)
+        , batchSize_(1)
         , running_(false)
         , packetsTransmitted_(0)
-        , bytesTransmitted_(0) {}
+        , bytesTransmitted_(0)
+        , packetsDropped_(0) {}
 
-    ~TrafficShaper() {
+    ~BasicTrafficShaper() {
         stop();
     }
     
@@ -32,11 +69,19 @@ public:
         flows_[flow->getFlowId()] = flow;
     }
 
+    // Packets sent per batch (1: one at a time). Must be set before start().
+    void setBatchSize(size_t batchSize) {
+        batchSize_ = std::max<size_t>(batchSize, 1);
+    }
+
+    size_t getBatchSize() const { return batchSize_; }
+
     void start() {
         if (running_) return;
         
         running_ = true;
-        thread_ = std::thread(&TrafficShaper::processPackets, this);
+        thread_ = std::thread(batchSize_ > 1 ? &BasicTrafficShaper::processBatches
+                                             : &BasicTrafficShaper::processPackets, this);
     }
 
     void stop() {
@@ -50,36 +95,46 @@ public:
 
     uint64_t getPacketsTransmitted() const { return packetsTransmitted_; }
     uint64_t getBytesTransmitted() const { return bytesTransmitted_; }
+    // Dequeued packets the shaper dropped instead of sending
+    uint64_t getPacketsDropped() const { return packetsDropped_; }
 
 private:
+    static constexpr uint64_t kMinTokenWaitNanos = 1000;     // 1us
+    static constexpr uint64_t kMaxTokenWaitNanos = 100000;   // 100us
+    static constexpr int64_t kMaxIdleWaitNanos = 100000;     // 100us
+    static constexpr size_t kMaxBatchFlows = 16;   // Flows totalled per batch
+
     void processPackets() {
         while (running_) {
             auto packet = inputQueue_->tryDequeue();
             
             if (!packet) {
-                // No packet available, sleep briefly
-                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                waitForEligible();
+                continue;
+            }
+            if (!admit(*packet)) {
                 continue;
             }
             
             // Try to consume tokens for this packet
-            while (running_ && !tokenBucket_->consume(packet->getSize())) {
-                // Not enough tokens, wait a bit
-                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            while (running_ && rateLimiter_ && !rateLimiter_->consume(packet->getSize())) {
+                waitForTokens(packet->getSize());
             }
             
-            if (!running_) break;
-            
-            // Calculate transmission time based on link capacity
-            // transmissionTime = (packetSize * 8) / linkCapacity (in seconds)
-            uint64_t transmissionTimeMicros = 
-                (packet->getSize() * 8 * 1000000ULL) / linkCapacity_;
+            if (!running_) {
+                drop(*packet);   // Stopped before it could be sent
+                break;
+            }
             
-            // Simulate transmission delay
-            std::this_thread::sleep_for(std::chrono::microseconds(transmissionTimeMicros));
+            // Book the link and wait out the packet's serialization time
+            // (packetSize * 8 / linkCapacity) behind whatever is booked
+            uint64_t bits = packet->getSize() * 8ULL;
+            auto departure = link_->reserve(bits) +
+                std::chrono::nanoseconds(link_->serializationNanos(bits));
+            std::this_thread::sleep_until(departure);
             
             // Mark packet as transmitted
-            packet->setTransmissionTime(std::chrono::high_resolution_clock::now());
+            packet->setTransmissionTime(departure);
             
             packetsTransmitted_++;
             bytesTransmitted_ += packet->getSize();
@@ -90,19 +145,182 @@ private:
                 double delay = std::chrono::duration<double, std::milli>(
                     packet->getTransmissionTime() - packet->getCreationTime()).count();
                 it->second->recordTransmission(packet->getSize(), delay);
+                it->second->onEcnEcho(packet->isCeMarked());
+            }
+        }
+    }
+
+    // Batched form of processPackets()
+    void processBatches() {
+        std::vector<std::shared_ptr<Packet>> batch;
+        std::vector<uint32_t> sizes;
+        batch.reserve(batchSize_);
+        sizes.reserve(batchSize_);
+
+        while (running_) {
+            batch.clear();
+            sizes.clear();
+            bool polled = false;
+            // Take only what the tokens on hand can pay for, plus at most
+            // one packet to wait on, so the rest stays in the discipline
+            // where it can still be scheduled, dropped and measured
+            uint64_t budget = rateLimiter_ ? rateLimiter_->getTokens() : UINT64_MAX;
+            uint64_t bytes = 0;
+            while (batch.size() < batchSize_ && (batch.empty() || bytes < budget)) {
+                auto packet = inputQueue_->tryDequeue();
+                if (!packet) {
+                    break;
+                }
+                polled = true;
+                if (!admit(*packet)) {
+                    continue;
+                }
+                bytes += packet->getSize();
+                sizes.push_back(packet->getSize());
+                batch.push_back(std::move(packet));
+            }
+            if (batch.empty()) {
+                if (polled) {
+                    continue;   // Everything dequeued was dropped
+                }
+                waitForEligible();
+                continue;
+            }
+
+            // Send whatever prefix the limiter accepts, then wait for the
+            // tokens of the next packet
+            uint32_t sent = 0;
+            uint32_t count = static_cast<uint32_t>(batch.size());
+            while (running_ && sent < count) {
+                uint32_t paid = rateLimiter_ ? rateLimiter_->consumeBatch(&sizes[sent], count - sent)
+                                             : count - sent;
+                if (paid > 0) {
+                    transmitBatch(&batch[sent], paid);
+                    sent += paid;
+                } else {
+                    waitForTokens(sizes[sent]);
+                }
+            }
+            for (; sent < count; sent++) {
+                drop(*batch[sent]);   // Stopped before they could be sent
+            }
+        }
+    }
+
+    // Puts 'count' paid packets on the link back to back: one booking and
+    // one sleep for their total serialization time, each stamped with its
+    // own departure
+    void transmitBatch(const std::shared_ptr<Packet>* packets, uint32_t count) {
+        uint64_t bits = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            bits += packets[i]->getSize() * 8ULL;
+        }
+        auto start = link_->reserve(bits);
+        bits = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            bits += packets[i]->getSize() * 8ULL;
+            packets[i]->setTransmissionTime(start + std::chrono::nanoseconds(
+                link_->serializationNanos(bits)));
+        }
+        std::this_thread::sleep_until(start + std::chrono::nanoseconds(
+            link_->serializationNanos(bits)));
+
+        // Per-flow totals, usually over a handful of flows
+        struct FlowTotals {
+            Flow* flow;
+            uint64_t bytes;
+            double delay;
+            uint64_t misses;
+        };
+        FlowTotals totals[kMaxBatchFlows];
+        size_t numTotals = 0;
+        uint64_t bytes = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            const Packet& packet = *packets[i];
+            bytes += packet.getSize();
+            auto it = flows_.find(packet.getFlowId());
+            if (it == flows_.end()) {
+                continue;
             }
+            Flow* flow = it->second.get();
+            double delay = std::chrono::duration<double, std::milli>(
+                packet.getTransmissionTime() - packet.getCreationTime()).count();
+            flow->onEcnEcho(packet.isCeMarked());
+
+            size_t slot = 0;
+            while (slot < numTotals && totals[slot].flow != flow) {
+                slot++;
+            }
+            if (slot == numTotals) {
+                if (numTotals == kMaxBatchFlows) {
+                    flow->recordTransmission(packet.getSize(), delay);
+                    continue;
+                }
+                totals[numTotals++] = FlowTotals{flow, 0, 0.0, 0};
+            }
+            totals[slot].bytes += packet.getSize();
+            totals[slot].delay += delay;
+            totals[slot].misses += flow->isLate(delay) ? 1 : 0;
+        }
+        for (size_t slot = 0; slot < numTotals; slot++) {
+            totals[slot].flow->recordTransmissions(totals[slot].bytes, totals[slot].delay,
+                                                   totals[slot].misses);
+        }
+
+        packetsTransmitted_ += count;
+        bytesTransmitted_ += bytes;
+    }
+
+    // Drops a packet that no bucket of the limiter could ever hold
+    bool admit(const Packet& packet) {
+        if (!rateLimiter_ || packet.getSize() <= rateLimiter_->getMaxPacketSize()) {
+            return true;
+        }
+        drop(packet);
+        return false;
+    }
+
+    void drop(const Packet& packet) {
+        packetsDropped_++;
+        auto it = flows_.find(packet.getFlowId());
+        if (it != flows_.end()) {
+            it->second->recordDrop();
         }
     }
 
-    std::shared_ptr<PacketQueue> inputQueue_;
-    std::shared_ptr<TokenBucket> tokenBucket_;
-    uint64_t linkCapacity_;  // bits per second
+    // Nothing eligible: sleep until the discipline expects to release a
+    // packet, capped so new arrivals are not missed
+    void waitForEligible() {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+        int64_t next = inputQueue_->nextEligibleTime();
+        int64_t waitNanos = next > now ? std::min(next - now, kMaxIdleWaitNanos)
+                                       : static_cast<int64_t>(kMinTokenWaitNanos);
+        std::this_thread::sleep_for(std::chrono::nanoseconds(waitNanos));
+    }
+
+    // Not enough tokens: sleep until they are due, capped so that stop()
+    // stays responsive
+    void waitForTokens(uint32_t size) {
+        uint64_t waitNanos = std::min<uint64_t>(
+            rateLimiter_->nanosUntilAvailable(size), kMaxTokenWaitNanos);
+        std::this_thread::sleep_for(std::chrono::nanoseconds(
+            std::max<uint64_t>(waitNanos, kMinTokenWaitNanos)));
+    }
+
+    std::shared_ptr<Queue> inputQueue_;
+    std::shared_ptr<RateLimiter> rateLimiter_;
+    std::shared_ptr<Link> link_;
     std::unordered_map<uint32_t, std::shared_ptr<Flow>> flows_;
+    size_t batchSize_;
     
     std::atomic<bool> running_;
     std::atomic<uint64_t> packetsTransmitted_;
     std::atomic<uint64_t> bytesTransmitted_;
+    std::atomic<uint64_t> packetsDropped_;
     std::thread thread_;
 };
 
+using TrafficShaper = BasicTrafficShaper<QueueDiscipline>;
+
 #endif // TRAFFIC_SHAPER_H
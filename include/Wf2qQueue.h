@@ -0,0 +1,187 @@
+#ifndef WF2Q_QUEUE_H
+#define WF2Q_QUEUE_H
+
+#include "QueueDiscipline.h"
+#include "PacketSlotPool.h"
+#include "FixedPoint.h"
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <utility>
+#include <cstdint>
+
+// WF²Q+ (Bennett & Zhang) worst-case fair weighted fair queueing. Each flow
+// has a guaranteed rate; its head packet carries a virtual start tag S and
+// finish tag F = S + size / rate. The system virtual time V advances by
+// size / linkRate per packet sent and never falls behind the smallest start
+// tag of a backlogged flow. A flow is eligible once S <= V, and the eligible
+// flow with the smallest F sends next.
+//
+// Only head packets are tagged, so each backlogged flow sits in exactly one
+// of two heaps: ineligible flows keyed by S, eligible ones keyed by F. A
+// dequeue moves newly eligible flows across and pops the best, O(log n) per
+// packet. A flow with guaranteed rate r and burst sigma sees delay at most
+// (sigma + Lflow) / r + Lmax / linkRate, provided the rates sum to at most
+// linkRate.
+class Wf2qQueue final : public QueueDiscipline {
+public:
+    // linkRate in bytes/sec; flows without setRate() get 'defaultRate'
+    // (0: the link rate, i.e. equal weights)
+    Wf2qQueue(uint64_t linkRate, size_t maxSize = 1000, uint64_t defaultRate = 0)
+        : pool_(maxSize)
+        , linkCost_(costPerByte(linkRate))
+        , defaultCost_(costPerByte(defaultRate > 0 ? defaultRate : linkRate))
+        , virtualTime_(0)
+        , totalDropped_(0) {}
+
+    // Guaranteed rate of a flow (bytes/sec)
+    void setRate(uint32_t flowId, uint64_t rate) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flows_[slotFor(flowId)].cost = costPerByte(rate);
+    }
+
+    // Tail drop when the shared buffer is full
+    bool enqueue(std::shared_ptr<Packet> packet) override {
+        auto now = std::chrono::high_resolution_clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (pool_.full()) {
+            totalDropped_++;
+            return false;
+        }
+
+        packet->setEnqueueTime(now);
+        uint32_t slot = slotFor(packet->getFlowId());
+        FlowState& flow = flows_[slot];
+        bool wasIdle = flow.packets.empty();
+        uint32_t size = packet->getSize();
+        pool_.push(flow.packets, std::move(packet));
+        telemetry_.recordEnqueue(pool_.used(), toNanos(now));
+
+        if (wasIdle) {
+            flow.start = std::max(flow.finish, virtualTime_);
+            flow.finish = flow.start + tagLength(flow, size);
+            schedule(slot);
+        }
+        return true;
+    }
+
+    std::shared_ptr<Packet> tryDequeue() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = nowNanos();
+
+        auto packet = dequeueLocked();
+        if (packet) {
+            telemetry_.recordDequeue(pool_.used(), now,
+                                     now - toNanos(packet->getEnqueueTime()));
+        } else {
+            telemetry_.recordOccupancy(pool_.used(), now);
+        }
+        return packet;
+    }
+
+    size_t size() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used();
+    }
+
+    bool empty() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pool_.used() == 0;
+    }
+
+    size_t getTotalDropped() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return totalDropped_;
+    }
+
+private:
+    static constexpr unsigned kTimeShift = 8;    // Virtual time in 1/256 ns
+    static constexpr unsigned kCostShift = 32;   // Fraction bits of a cost
+
+    using HeapEntry = std::pair<uint64_t, uint32_t>;   // Tag, slot
+    using MinHeap = std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+                                        std::greater<HeapEntry>>;
+
+    struct FlowState {
+        PacketSlotPool::List packets;
+        uint64_t cost = 0;      // ns per byte at the flow's rate, scaled by 2^kCostShift
+        uint64_t start = 0;     // Virtual start tag of the head packet
+        uint64_t finish = 0;    // Virtual finish tag of the head packet
+    };
+
+    static uint64_t costPerByte(uint64_t rate) {
+        return FixedPoint::scaledRatio(1000000000ULL, rate > 0 ? rate : 1, kCostShift);
+    }
+
+    static uint64_t tagLength(const FlowState& flow, uint32_t bytes) {
+        return FixedPoint::mulShr(bytes, flow.cost, kCostShift - kTimeShift);
+    }
+
+    uint32_t slotFor(uint32_t flowId) {
+        auto it = slots_.find(flowId);
+        if (it != slots_.end()) {
+            return it->second;
+        }
+        uint32_t slot = static_cast<uint32_t>(flows_.size());
+        slots_.emplace(flowId, slot);
+        flows_.emplace_back();
+        flows_.back().cost = defaultCost_;
+        return slot;
+    }
+
+    // File a backlogged flow under its head packet's tags
+    void schedule(uint32_t slot) {
+        const FlowState& flow = flows_[slot];
+        if (flow.start <= virtualTime_) {
+            eligible_.emplace(flow.finish, slot);
+        } else {
+            ineligible_.emplace(flow.start, slot);
+        }
+    }
+
+    std::shared_ptr<Packet> dequeueLocked() {
+        if (eligible_.empty()) {
+            if (ineligible_.empty()) {
+                return nullptr;
+            }
+            // V never lags the smallest start tag, so someone is eligible
+            virtualTime_ = std::max(virtualTime_, ineligible_.top().first);
+        }
+        while (!ineligible_.empty() && ineligible_.top().first <= virtualTime_) {
+            uint32_t slot = ineligible_.top().second;
+            ineligible_.pop();
+            eligible_.emplace(flows_[slot].finish, slot);
+        }
+
+        uint32_t slot = eligible_.top().second;
+        eligible_.pop();
+        FlowState& flow = flows_[slot];
+        auto packet = pool_.pop(flow.packets);
+        virtualTime_ += FixedPoint::mulShr(packet->getSize(), linkCost_, kCostShift - kTimeShift);
+
+        if (!flow.packets.empty()) {
+            flow.start = flow.finish;
+            flow.finish = flow.start + tagLength(flow, pool_.front(flow.packets)->getSize());
+            schedule(slot);
+        }
+        return packet;
+    }
+
+    PacketSlotPool pool_;
+    std::unordered_map<uint32_t, uint32_t> slots_;  // Flow id -> slot
+    std::vector<FlowState> flows_;
+    MinHeap eligible_;        // Backlogged flows with S <= V, by F
+    MinHeap ineligible_;      // Backlogged flows with S > V, by S
+    uint64_t linkCost_;       // ns per byte at the link rate, scaled
+    uint64_t defaultCost_;
+    uint64_t virtualTime_;    // System virtual time V
+
+    size_t totalDropped_;
+    mutable std::mutex mutex_;
+};
+
+#endif // WF2Q_QUEUE_H
@@ -1,15 +1,34 @@
 #include "Flow.h"
 #include "Packet.h"
 #include "PacketQueue.h"
+#include "FqCoDelQueue.h"
+#include "ShardedPacketQueue.h"
+#include "HtbQueue.h"
+#include "HfscQueue.h"
+#include "RoundRobinQueue.h"
+#include "DrrQueue.h"
+#include "Wf2qQueue.h"
+#include "EdfQueue.h"
+#include "SfqQueue.h"
+#include "TimingWheelQueue.h"
+#include "MultiQueueDiscipline.h"
+#include "PifoRanks.h"
+#include "ColorMarker.h"
 #include "TokenBucket.h"
+#include "RateSchedule.h"
 #include "TrafficGenerator.h"
-#include "TrafficShaper.h"
+#include "MultiQueueShaper.h"
 #include "StatisticsCollector.h"
 #include <iostream>
+#include <iomanip>
 #include <memory>
 #include <thread>
 #include <chrono>
 #include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdlib>
+#include <algorithm>
 
 void printBanner() {
     std::cout << "\n";
@@ -20,18 +39,407 @@ void printBanner() {
     std::cout << "\n";
 }
 
+// Command-line options shared by all scenarios
+struct SimulationOptions {
+    std::string discipline = "priority";
+    bool ecn = false;   // Flows send ECN-capable packets and react to CE marks
+    std::string marker; // Ingress color marker: empty, "srtcm" or "trtcm"
+    bool police = false; // Per-flow ingress policing at each flow's target rate
+    bool peakRate = false; // Shaper bucket drains at most at 2x the token rate
+    bool dropLate = false; // EDF drops packets already past their deadline
+    std::string pifoRank = "fq";  // Rank function of the pifo discipline
+    size_t txQueues = 1;  // TX queues, each with its own discipline and shaper thread
+    size_t batchSize = 1; // Packets the shaper dequeues, pays for and sends at once
+    std::string scheduleFile;  // Rate trace the shaper bucket follows, if any
+    std::shared_ptr<const RateSchedule> schedule;
+};
+
+constexpr uint32_t kPeakRateMtu = 1514;
+constexpr size_t kMaxTxQueues = 64;
+constexpr size_t kMaxBatchSize = 1024;
+
+// Queue disciplines selectable from the command line, in the order
+// "compare" runs them
+const std::vector<std::string> kDisciplines = {"priority", "rr", "drr", "wf2q", "edf",
+                                               "sfq", "fq_codel", "sharded", "htb",
+                                               "hfsc", "pace", "pifo"};
+
+// Rank functions the pifo discipline can use
+const std::vector<std::string> kPifoRanks = {"fifo", "fq", "edf", "srpt", "lstf"};
+
+bool isKnownDiscipline(const std::string& name) {
+    return std::find(kDisciplines.begin(), kDisciplines.end(), name) != kDisciplines.end();
+}
+
+// HTB tree for a scenario: root at the token rate, two tenants splitting the
+// flows, and one leaf per flow with an equal share as its assured rate.
+// Every class may borrow up to the full rate; higher-priority flows get
+// spare bandwidth first.
+std::shared_ptr<HtbQueue> makeHtbQueue(size_t queueSize, uint64_t tokenRate,
+                                       uint64_t bucketSize,
+                                       const std::vector<std::shared_ptr<Flow>>& flows) {
+    auto htb = std::make_shared<HtbQueue>(tokenRate, queueSize, bucketSize);
+    size_t numFlows = std::max<size_t>(flows.size(), 1);
+    size_t firstTenantFlows = (numFlows + 1) / 2;
+
+    uint32_t tenants[2] = {
+        htb->addClass(HtbQueue::kRoot, tokenRate * firstTenantFlows / numFlows, tokenRate),
+        htb->addClass(HtbQueue::kRoot, tokenRate * (numFlows - firstTenantFlows) / numFlows,
+                      tokenRate),
+    };
+    for (size_t i = 0; i < flows.size(); i++) {
+        unsigned prio = static_cast<unsigned>(PacketPriority::CRITICAL) -
+                        static_cast<unsigned>(flows[i]->getPriority());
+        uint32_t leaf = htb->addClass(tenants[i < firstTenantFlows ? 0 : 1],
+                                      tokenRate / numFlows, tokenRate, prio);
+        htb->assignFlow(flows[i]->getFlowId(), leaf);
+    }
+    return htb;
+}
+
+// HFSC tree for a scenario: flows with a latency budget under a real-time
+// tenant, the rest under a bulk tenant. Tenants and leaves share the token
+// rate by link sharing in proportion to target rates. Each budgeted flow
+// also gets a real-time curve at half its share that delivers one MTU
+// within its budget. The budget holds whatever the bulk flows send only
+// while the flow sends at or below that real-time rate; beyond it, the
+// excess waits for link sharing and its delay grows with the backlog.
+std::shared_ptr<HfscQueue> makeHfscQueue(size_t queueSize, uint64_t tokenRate,
+                                         const std::vector<std::shared_ptr<Flow>>& flows) {
+    using Curve = HfscQueue::ServiceCurve;
+    auto hfsc = std::make_shared<HfscQueue>(queueSize);
+
+    uint64_t totalRate = 0;
+    uint64_t tenantRate[2] = {0, 0};   // Real-time, bulk
+    for (const auto& flow : flows) {
+        uint64_t rate = std::max<uint64_t>(flow->getTargetRate(), 1);
+        totalRate += rate;
+        tenantRate[flow->getLatencyBudget().count() > 0 ? 0 : 1] += rate;
+    }
+    auto share = [&](uint64_t rate) {
+        return std::max<uint64_t>(static_cast<uint64_t>(
+            static_cast<double>(tokenRate) * rate / std::max<uint64_t>(totalRate, 1)), 1);
+    };
+
+    uint32_t tenants[2] = {HfscQueue::kNoClass, HfscQueue::kNoClass};
+    for (int i = 0; i < 2; i++) {
+        if (tenantRate[i] > 0) {
+            tenants[i] = hfsc->addClass(HfscQueue::kRoot, Curve(),
+                                        Curve::linear(share(tenantRate[i])));
+        }
+    }
+    for (const auto& flow : flows) {
+        uint64_t rate = share(std::max<uint64_t>(flow->getTargetRate(), 1));
+        bool realTime = flow->getLatencyBudget().count() > 0;
+        Curve rt = realTime ? Curve::fromDelay(HfscQueue::kMtu, flow->getLatencyBudget(),
+                                               std::max<uint64_t>(rate / 2, 1))
+                            : Curve();
+        uint32_t leaf = hfsc->addClass(tenants[realTime ? 0 : 1], rt, Curve::linear(rate));
+        hfsc->assignFlow(flow->getFlowId(), leaf);
+    }
+    return hfsc;
+}
+
+// DRR weighted by target rate: the slowest flow gets one MTU per round and
+// the others proportionally more, so every quantum covers a full packet
+std::shared_ptr<DrrQueue> makeDrrQueue(size_t queueSize,
+                                       const std::vector<std::shared_ptr<Flow>>& flows) {
+    auto drr = std::make_shared<DrrQueue>(queueSize);
+    uint64_t minRate = UINT64_MAX;
+    for (const auto& flow : flows) {
+        minRate = std::min<uint64_t>(minRate, std::max<uint64_t>(flow->getTargetRate(), 1));
+    }
+    for (const auto& flow : flows) {
+        uint64_t quantum = DrrQueue::kMtu * std::max<uint64_t>(flow->getTargetRate(), 1) / minRate;
+        drr->setQuantum(flow->getFlowId(),
+                        static_cast<uint32_t>(std::min<uint64_t>(quantum, UINT32_MAX)));
+    }
+    return drr;
+}
+
+// WF²Q+ on a link at the token rate, split into guaranteed rates in
+// proportion to the flows' target rates
+std::shared_ptr<Wf2qQueue> makeWf2qQueue(size_t queueSize, uint64_t tokenRate,
+                                         const std::vector<std::shared_ptr<Flow>>& flows) {
+    auto wf2q = std::make_shared<Wf2qQueue>(tokenRate, queueSize);
+    uint64_t totalRate = 0;
+    for (const auto& flow : flows) {
+        totalRate += std::max<uint64_t>(flow->getTargetRate(), 1);
+    }
+    for (const auto& flow : flows) {
+        wf2q->setRate(flow->getFlowId(), static_cast<uint64_t>(
+            static_cast<double>(tokenRate) * std::max<uint64_t>(flow->getTargetRate(), 1) /
+            totalRate));
+    }
+    return wf2q;
+}
+
+// EDF with each flow's latency budget; flows without one get EdfQueue's
+// default of one second
+std::shared_ptr<EdfQueue> makeEdfQueue(size_t queueSize,
+                                       const std::vector<std::shared_ptr<Flow>>& flows,
+                                       bool dropLate) {
+    auto edf = std::make_shared<EdfQueue>(queueSize);
+    for (const auto& flow : flows) {
+        if (flow->getLatencyBudget().count() > 0) {
+            edf->setBudget(flow->getFlowId(), flow->getLatencyBudget());
+        }
+    }
+    edf->setDropLate(dropLate);
+    return edf;
+}
+
+// Timing wheel pacing each flow at its target rate
+std::shared_ptr<TimingWheelQueue> makeTimingWheelQueue(size_t queueSize,
+                                                       const std::vector<std::shared_ptr<Flow>>& flows) {
+    auto wheel = std::make_shared<TimingWheelQueue>(queueSize);
+    for (const auto& flow : flows) {
+        wheel->setRate(flow->getFlowId(), flow->getTargetRate());
+    }
+    return wheel;
+}
+
+// PIFO with one of the PifoRanks policies. Time ranks use 16 us buckets
+// (a 1 s window); fair queueing weights flows by target rate, as DRR does;
+// srpt has no flow sizes here, so it ranks by bytes sent; lstf takes the
+// token rate as the link rate.
+std::shared_ptr<PifoQueue> makePifoQueue(size_t queueSize, uint64_t tokenRate,
+                                         const std::vector<std::shared_ptr<Flow>>& flows,
+                                         const std::string& rank) {
+    std::unordered_map<uint32_t, std::chrono::microseconds> budgets;
+    uint64_t minRate = UINT64_MAX;
+    for (const auto& flow : flows) {
+        if (flow->getLatencyBudget().count() > 0) {
+            budgets[flow->getFlowId()] = flow->getLatencyBudget();
+        }
+        minRate = std::min<uint64_t>(minRate, std::max<uint64_t>(flow->getTargetRate(), 1));
+    }
+
+    if (rank == "fq") {
+        std::unordered_map<uint32_t, uint32_t> weights;
+        for (const auto& flow : flows) {
+            uint64_t weight = PifoRanks::kShare * std::max<uint64_t>(flow->getTargetRate(), 1) / minRate;
+            weights[flow->getFlowId()] = static_cast<uint32_t>(std::min<uint64_t>(weight, UINT32_MAX));
+        }
+        return std::make_shared<PifoQueue>(PifoRanks::fairQueueing(std::move(weights)),
+                                           queueSize, 65536, 4);
+    }
+    if (rank == "srpt") {
+        return std::make_shared<PifoQueue>(PifoRanks::srpt(), queueSize, 65536, 10);
+    }
+    if (rank == "edf") {
+        return std::make_shared<PifoQueue>(PifoRanks::edf(std::move(budgets)),
+                                           queueSize, 65536, 14);
+    }
+    if (rank == "lstf") {
+        return std::make_shared<PifoQueue>(PifoRanks::lstf(std::move(budgets), tokenRate),
+                                           queueSize, 65536, 14);
+    }
+    return std::make_shared<PifoQueue>(PifoRanks::fifo(), queueSize, 65536, 14);
+}
+
+std::shared_ptr<QueueDiscipline> makeQueueDiscipline(size_t queueSize,
+                                                     uint64_t tokenRate,
+                                                     uint64_t bucketSize,
+                                                     const std::vector<std::shared_ptr<Flow>>& flows,
+                                                     const SimulationOptions& options) {
+    const std::string& name = options.discipline;
+    if (name == "htb") {
+        return makeHtbQueue(queueSize, tokenRate, bucketSize, flows);
+    }
+    if (name == "hfsc") {
+        return makeHfscQueue(queueSize, tokenRate, flows);
+    }
+    if (name == "pace") {
+        return makeTimingWheelQueue(queueSize, flows);
+    }
+    if (name == "sfq") {
+        return std::make_shared<SfqQueue>(queueSize);
+    }
+    if (name == "fq_codel") {
+        return std::make_shared<FqCoDelQueue>(queueSize);
+    }
+    if (name == "sharded") {
+        return std::make_shared<ShardedPacketQueue>(queueSize);
+    }
+    if (name == "rr") {
+        return std::make_shared<RoundRobinQueue>(queueSize);
+    }
+    if (name == "drr") {
+        return makeDrrQueue(queueSize, flows);
+    }
+    if (name == "wf2q") {
+        return makeWf2qQueue(queueSize, tokenRate, flows);
+    }
+    if (name == "edf") {
+        return makeEdfQueue(queueSize, flows, options.dropLate);
+    }
+    if (name == "pifo") {
+        return makePifoQueue(queueSize, tokenRate, flows, options.pifoRank);
+    }
+    return std::make_shared<PacketQueue>(queueSize);
+}
+
+// The scenario's discipline on each of options.txQueues TX queues. Each
+// queue gets the flows hashed to it and an equal part of the buffer, so the
+// total buffer is the same for any queue count; every queue's scheduler is
+// sized to the full token rate, and the shared shaper bucket caps the sum.
+std::shared_ptr<MultiQueueDiscipline> makeTxQueues(size_t queueSize,
+                                                   uint64_t tokenRate,
+                                                   uint64_t bucketSize,
+                                                   const std::vector<std::shared_ptr<Flow>>& flows,
+                                                   const SimulationOptions& options) {
+    size_t numQueues = std::max<size_t>(options.txQueues, 1);
+    std::vector<std::shared_ptr<QueueDiscipline>> queues;
+    for (size_t i = 0; i < numQueues; i++) {
+        std::vector<std::shared_ptr<Flow>> queueFlows;
+        for (const auto& flow : flows) {
+            if (MultiQueueDiscipline::queueFor(flow->getFlowId(), numQueues) == i) {
+                queueFlows.push_back(flow);
+            }
+        }
+        queues.push_back(makeQueueDiscipline((queueSize + numQueues - 1) / numQueues,
+                                             tokenRate, bucketSize, queueFlows, options));
+    }
+    return std::make_shared<MultiQueueDiscipline>(std::move(queues));
+}
+
+bool isKnownMarker(const std::string& name) {
+    return name == "srtcm" || name == "trtcm";
+}
+
+// Ingress policer contract derived from the shaper's token bucket: CIR is
+// the token rate, and the excess/peak allowance adds another bucket's worth
+// of burst (trTCM: at 1.25x the token rate)
+std::shared_ptr<ColorMarker> makeColorMarker(const std::string& name,
+                                             uint64_t tokenRate, uint64_t bucketSize) {
+    if (name == "srtcm") {
+        return std::make_shared<SrTcmMarker>(tokenRate, bucketSize, bucketSize);
+    }
+    if (name == "trtcm") {
+        return std::make_shared<TrTcmMarker>(tokenRate, bucketSize,
+                                             tokenRate * 5 / 4, bucketSize);
+    }
+    return nullptr;
+}
+
+// Per-flow contracts at each flow's target rate with 100 ms of burst
+std::shared_ptr<PolicerTable> makePolicerTable(const std::vector<std::shared_ptr<Flow>>& flows) {
+    auto table = std::make_shared<PolicerTable>();
+    for (const auto& flow : flows) {
+        table->setContract(flow->getFlowId(), flow->getTargetRate(),
+                           std::max<uint64_t>(flow->getTargetRate() / 10, 1500));
+    }
+    return table;
+}
+
+// Shaper bucket for a scenario. A rate schedule starts with the scenario
+// and replaces the token rate.
+std::shared_ptr<TokenBucket> makeTokenBucket(uint64_t tokenRate, uint64_t bucketSize,
+                                             const SimulationOptions& options) {
+    auto tokenBucket = std::make_shared<TokenBucket>(tokenRate, bucketSize);
+    if (options.peakRate) {
+        tokenBucket->setPeakRate(2 * tokenRate, kPeakRateMtu);
+    }
+    if (options.schedule) {
+        tokenBucket->setRateSchedule(options.schedule);
+    }
+    return tokenBucket;
+}
+
+// Pacing replaces the shared bucket: the wheel already spaces each flow's
+// packets, so the shaper sends them as they come due
+std::shared_ptr<RateLimiter> shaperLimiter(std::shared_ptr<TokenBucket> tokenBucket,
+                                           const SimulationOptions& options) {
+    if (options.discipline == "pace") {
+        return nullptr;
+    }
+    return tokenBucket;
+}
+
+// Default options keep the original file names so existing plots still work
+std::string resultsPath(int scenario, const SimulationOptions& options,
+                        const std::string& variant = "") {
+    std::string name = "results/scenario" + std::to_string(scenario) + variant;
+    if (options.discipline != "priority") {
+        name += "_" + options.discipline;
+    }
+    if (options.discipline == "pifo") {
+        name += "_" + options.pifoRank;
+    }
+    if (options.ecn) {
+        name += "_ecn";
+    }
+    if (!options.marker.empty()) {
+        name += "_" + options.marker;
+    }
+    if (options.police) {
+        name += "_police";
+    }
+    if (options.peakRate) {
+        name += "_peak";
+    }
+    if (options.dropLate) {
+        name += "_droplate";
+    }
+    if (options.schedule) {
+        name += "_sched";
+    }
+    if (options.txQueues > 1) {
+        name += "_tx" + std::to_string(options.txQueues);
+    }
+    if (options.batchSize > 1) {
+        name += "_batch" + std::to_string(options.batchSize);
+    }
+    return name + "_stats.csv";
+}
+
+void applyFlowOptions(const std::vector<std::shared_ptr<Flow>>& flows,
+                      const SimulationOptions& options) {
+    for (const auto& flow : flows) {
+        flow->setEcnCapable(options.ecn);
+    }
+}
+
 void printConfiguration(uint64_t linkCapacity, uint64_t tokenRate, 
-                       uint64_t bucketSize, size_t queueSize) {
+                       uint64_t bucketSize, size_t queueSize,
+                       const SimulationOptions& options) {
     std::cout << "Simulation Configuration:\n";
     std::cout << "-------------------------\n";
     std::cout << "Link Capacity:     " << (linkCapacity / 1000000) << " Mbps\n";
     std::cout << "Token Rate:        " << (tokenRate / 1024) << " KB/s\n";
+    if (options.schedule) {
+        std::cout << "Rate Schedule:     " << options.scheduleFile << " ("
+                  << options.schedule->size() << " segments"
+                  << (options.schedule->getPeriod() > 0 ? ", periodic" : "")
+                  << ", replaces the token rate)\n";
+    }
     std::cout << "Bucket Size:       " << (bucketSize / 1024) << " KB\n";
+    if (options.peakRate) {
+        std::cout << "Peak Rate:         " << (2 * tokenRate / 1024) << " KB/s (mtu "
+                  << kPeakRateMtu << ")\n";
+    }
     std::cout << "Max Queue Size:    " << queueSize << " packets\n";
+    std::cout << "Queue Discipline:  " << options.discipline
+              << (options.dropLate ? " (drop late packets)" : "")
+              << (options.discipline == "pifo" ? " (rank " + options.pifoRank + ")" : "")
+              << (options.discipline == "pace" ? " (flows paced at their target rates,"
+                                                 " no token bucket)" : "") << "\n";
+    if (options.txQueues > 1) {
+        std::cout << "TX Queues:         " << options.txQueues
+                  << " (flows hashed by id, one shaper thread each, sharing the link"
+                  << " and token bucket)\n";
+    }
+    if (options.batchSize > 1) {
+        std::cout << "Transmit Batch:    up to " << options.batchSize << " packets\n";
+    }
+    std::cout << "ECN:               " << (options.ecn ? "enabled" : "disabled") << "\n";
+    std::cout << "Ingress Marker:    " << (options.marker.empty() ? "none" : options.marker) << "\n";
+    std::cout << "Per-Flow Policing: " << (options.police ? "enabled" : "disabled") << "\n";
     std::cout << "\n";
 }
 
-void runScenario1() {
+void runScenario1(const SimulationOptions& options) {
     std::cout << "\n========== Scenario 1: Basic Traffic Shaping ==========\n";
     std::cout << "Testing TBF with 3 constant-rate flows\n";
     std::cout << "Observing queue behavior and flow fairness\n\n";
@@ -42,11 +450,10 @@ void runScenario1() {
     uint64_t bucketSize = 100 * 1024;      // 100 KB
     size_t queueSize = 500;                // 500 packets
 
-    printConfiguration(linkCapacity, tokenRate, bucketSize, queueSize);
+    printConfiguration(linkCapacity, tokenRate, bucketSize, queueSize, options);
 
     // Create components
-    auto queue = std::make_shared<PacketQueue>(queueSize);
-    auto tokenBucket = std::make_shared<TokenBucket>(tokenRate, bucketSize);
+    auto tokenBucket = makeTokenBucket(tokenRate, bucketSize, options);
     
     // Create flows
     auto flow1 = std::make_shared<Flow>(1, FlowType::CONSTANT_RATE, 
@@ -57,6 +464,8 @@ void runScenario1() {
                                         400 * 1024, PacketPriority::MEDIUM);
     
     std::vector<std::shared_ptr<Flow>> flows = {flow1, flow2, flow3};
+    applyFlowOptions(flows, options);
+    auto queue = makeTxQueues(queueSize, tokenRate, bucketSize, flows, options);
     
     std::cout << "Flows:\n";
     for (const auto& flow : flows) {
@@ -67,11 +476,17 @@ void runScenario1() {
 
     // Create traffic generator and shaper
     auto generator = std::make_shared<TrafficGenerator>(queue);
+    generator->setColorMarker(makeColorMarker(options.marker, tokenRate, bucketSize));
+    if (options.police) {
+        generator->setPolicer(makePolicerTable(flows));
+    }
     for (const auto& flow : flows) {
         generator->addFlow(flow);
     }
     
-    auto shaper = std::make_shared<TrafficShaper>(queue, tokenBucket, linkCapacity);
+    auto shaper = std::make_shared<MultiQueueShaper>(queue, shaperLimiter(tokenBucket, options),
+                                                     linkCapacity);
+    shaper->setBatchSize(options.batchSize);
     for (const auto& flow : flows) {
         shaper->addFlow(flow);
     }
@@ -99,12 +514,13 @@ void runScenario1() {
     
     // Print and save statistics
     statsCollector->printSummary();
-    statsCollector->saveToCSV("results/scenario1_stats.csv");
-    std::cout << "Statistics saved to: results/scenario1_stats.csv\n";
-    std::cout << "Run: python visualize.py results/scenario1_stats.csv\n";
+    std::string csvPath = resultsPath(1, options);
+    statsCollector->saveToCSV(csvPath);
+    std::cout << "Statistics saved to: " << csvPath << "\n";
+    std::cout << "Run: python visualize.py " << csvPath << "\n";
 }
 
-void runScenario2() {
+void runScenario2(const SimulationOptions& options) {
     std::cout << "\n========== Scenario 2: Priority-Based QoS ==========\n";
     std::cout << "Testing QoS with different priority flows\n";
     std::cout << "Observing priority-based packet scheduling\n\n";
@@ -115,10 +531,9 @@ void runScenario2() {
     uint64_t bucketSize = 80 * 1024;       // 80 KB
     size_t queueSize = 400;
 
-    printConfiguration(linkCapacity, tokenRate, bucketSize, queueSize);
+    printConfiguration(linkCapacity, tokenRate, bucketSize, queueSize, options);
 
-    auto queue = std::make_shared<PacketQueue>(queueSize);
-    auto tokenBucket = std::make_shared<TokenBucket>(tokenRate, bucketSize);
+    auto tokenBucket = makeTokenBucket(tokenRate, bucketSize, options);
     
     // Create flows with different priorities
     auto flow1 = std::make_shared<Flow>(1, FlowType::CONSTANT_RATE, 
@@ -128,19 +543,33 @@ void runScenario2() {
     auto flow3 = std::make_shared<Flow>(3, FlowType::CONSTANT_RATE, 
                                         300 * 1024, PacketPriority::LOW);
     
+    // Latency SLAs to match: edf schedules by them, and every discipline
+    // reports misses against them
+    flow1->setLatencyBudget(std::chrono::milliseconds(50));
+    flow2->setLatencyBudget(std::chrono::milliseconds(200));
+    flow3->setLatencyBudget(std::chrono::milliseconds(1000));
+    
     std::vector<std::shared_ptr<Flow>> flows = {flow1, flow2, flow3};
+    applyFlowOptions(flows, options);
+    auto queue = makeTxQueues(queueSize, tokenRate, bucketSize, flows, options);
     
     std::cout << "Flows:\n";
-    std::cout << "  Flow 1: 300 KB/s (HIGH Priority)\n";
-    std::cout << "  Flow 2: 300 KB/s (MEDIUM Priority)\n";
-    std::cout << "  Flow 3: 300 KB/s (LOW Priority)\n\n";
+    std::cout << "  Flow 1: 300 KB/s (HIGH Priority, 50 ms budget)\n";
+    std::cout << "  Flow 2: 300 KB/s (MEDIUM Priority, 200 ms budget)\n";
+    std::cout << "  Flow 3: 300 KB/s (LOW Priority, 1000 ms budget)\n\n";
 
     auto generator = std::make_shared<TrafficGenerator>(queue);
+    generator->setColorMarker(makeColorMarker(options.marker, tokenRate, bucketSize));
+    if (options.police) {
+        generator->setPolicer(makePolicerTable(flows));
+    }
     for (const auto& flow : flows) {
         generator->addFlow(flow);
     }
     
-    auto shaper = std::make_shared<TrafficShaper>(queue, tokenBucket, linkCapacity);
+    auto shaper = std::make_shared<MultiQueueShaper>(queue, shaperLimiter(tokenBucket, options),
+                                                     linkCapacity);
+    shaper->setBatchSize(options.batchSize);
     for (const auto& flow : flows) {
         shaper->addFlow(flow);
     }
@@ -163,12 +592,13 @@ void runScenario2() {
     queue->shutdown();
     
     statsCollector->printSummary();
-    statsCollector->saveToCSV("results/scenario2_stats.csv");
-    std::cout << "Statistics saved to: results/scenario2_stats.csv\n";
-    std::cout << "Run: python visualize.py results/scenario2_stats.csv\n";
+    std::string csvPath = resultsPath(2, options);
+    statsCollector->saveToCSV(csvPath);
+    std::cout << "Statistics saved to: " << csvPath << "\n";
+    std::cout << "Run: python visualize.py " << csvPath << "\n";
 }
 
-void runScenario3() {
+void runScenario3(const SimulationOptions& options) {
     std::cout << "\n========== Scenario 3: Bursty Traffic Handling ==========\n";
     std::cout << "Testing TBF with mix of bursty and constant flows\n";
     std::cout << "Observing congestion control and buffer management\n\n";
@@ -179,10 +609,9 @@ void runScenario3() {
     uint64_t bucketSize = 150 * 1024;      // 150 KB (larger for bursts)
     size_t queueSize = 600;
 
-    printConfiguration(linkCapacity, tokenRate, bucketSize, queueSize);
+    printConfiguration(linkCapacity, tokenRate, bucketSize, queueSize, options);
 
-    auto queue = std::make_shared<PacketQueue>(queueSize);
-    auto tokenBucket = std::make_shared<TokenBucket>(tokenRate, bucketSize);
+    auto tokenBucket = makeTokenBucket(tokenRate, bucketSize, options);
     
     // Mix of flow types
     auto flow1 = std::make_shared<Flow>(1, FlowType::BURSTY, 
@@ -193,6 +622,8 @@ void runScenario3() {
                                         350 * 1024, PacketPriority::MEDIUM);
     
     std::vector<std::shared_ptr<Flow>> flows = {flow1, flow2, flow3};
+    applyFlowOptions(flows, options);
+    auto queue = makeTxQueues(queueSize, tokenRate, bucketSize, flows, options);
     
     std::cout << "Flows:\n";
     std::cout << "  Flow 1: 400 KB/s (BURSTY)\n";
@@ -200,11 +631,17 @@ void runScenario3() {
     std::cout << "  Flow 3: 350 KB/s (POISSON)\n\n";
 
     auto generator = std::make_shared<TrafficGenerator>(queue);
+    generator->setColorMarker(makeColorMarker(options.marker, tokenRate, bucketSize));
+    if (options.police) {
+        generator->setPolicer(makePolicerTable(flows));
+    }
     for (const auto& flow : flows) {
         generator->addFlow(flow);
     }
     
-    auto shaper = std::make_shared<TrafficShaper>(queue, tokenBucket, linkCapacity);
+    auto shaper = std::make_shared<MultiQueueShaper>(queue, shaperLimiter(tokenBucket, options),
+                                                     linkCapacity);
+    shaper->setBatchSize(options.batchSize);
     for (const auto& flow : flows) {
         shaper->addFlow(flow);
     }
@@ -227,16 +664,207 @@ void runScenario3() {
     queue->shutdown();
     
     statsCollector->printSummary();
-    statsCollector->saveToCSV("results/scenario3_stats.csv");
-    std::cout << "Statistics saved to: results/scenario3_stats.csv\n";
-    std::cout << "Run: python visualize.py results/scenario3_stats.csv\n";
+    std::string csvPath = resultsPath(3, options);
+    statsCollector->saveToCSV(csvPath);
+    std::cout << "Statistics saved to: " << csvPath << "\n";
+    std::cout << "Run: python visualize.py " << csvPath << "\n";
+}
+
+// One run of scenario 5; with packetLimit the shaper also enforces a
+// packets-per-second budget
+void runSmallPacketPhase(bool packetLimit, const SimulationOptions& options) {
+    uint64_t linkCapacity = 10 * 1000000;  // 10 Mbps
+    uint64_t tokenRate = 600 * 1024;       // 600 KB/s
+    uint64_t bucketSize = 80 * 1024;       // 80 KB
+    uint64_t packetRate = 3000;            // 3000 packets/s
+    uint64_t packetBurst = 300;            // 300 packets
+    size_t queueSize = 400;
+    auto duration = std::chrono::seconds(5);
+
+    std::cout << (packetLimit ? "\n--- Byte rate + packet rate limit ---\n"
+                              : "\n--- Byte rate limit only ---\n");
+    printConfiguration(linkCapacity, tokenRate, bucketSize, queueSize, options);
+    if (packetLimit) {
+        std::cout << "Packet Rate:       " << packetRate << " pps (burst "
+                  << packetBurst << " packets)\n\n";
+    }
+
+    auto tokenBucket = makeTokenBucket(tokenRate, bucketSize, options);
+    if (packetLimit) {
+        tokenBucket->setPacketRate(packetRate, packetBurst);
+    }
+
+    // A flood of minimum-size packets next to a bulk flow of full-size ones
+    auto flow1 = std::make_shared<Flow>(1, FlowType::CONSTANT_RATE,
+                                        300 * 1024, PacketPriority::MEDIUM);
+    auto flow2 = std::make_shared<Flow>(2, FlowType::CONSTANT_RATE,
+                                        400 * 1024, PacketPriority::MEDIUM);
+    flow1->setPacketSizeRange(64, 64);
+    flow2->setPacketSizeRange(1500, 1500);
+
+    std::vector<std::shared_ptr<Flow>> flows = {flow1, flow2};
+    applyFlowOptions(flows, options);
+    auto queue = makeTxQueues(queueSize, tokenRate, bucketSize, flows, options);
+
+    std::cout << "Flows:\n";
+    std::cout << "  Flow 1: 300 KB/s in 64 B packets\n";
+    std::cout << "  Flow 2: 400 KB/s in 1500 B packets\n\n";
+
+    auto generator = std::make_shared<TrafficGenerator>(queue);
+    generator->setColorMarker(makeColorMarker(options.marker, tokenRate, bucketSize));
+    if (options.police) {
+        generator->setPolicer(makePolicerTable(flows));
+    }
+    for (const auto& flow : flows) {
+        generator->addFlow(flow);
+    }
+
+    auto shaper = std::make_shared<MultiQueueShaper>(queue, shaperLimiter(tokenBucket, options),
+                                                     linkCapacity);
+    shaper->setBatchSize(options.batchSize);
+    for (const auto& flow : flows) {
+        shaper->addFlow(flow);
+    }
+
+    auto statsCollector = std::make_shared<StatisticsCollector>(flows, queue);
+    statsCollector->setSampleInterval(100);
+
+    std::cout << "Starting simulation...\n";
+    auto start = std::chrono::steady_clock::now();
+    generator->start();
+    shaper->start();
+    statsCollector->start();
+
+    std::this_thread::sleep_for(duration);
+
+    std::cout << "Stopping simulation...\n";
+    generator->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    shaper->stop();
+    double elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    statsCollector->stop();
+    queue->shutdown();
+
+    statsCollector->printSummary();
+
+    // Which budget the shaper ran out of (includes the initial bucket burst)
+    double pps = static_cast<double>(shaper->getPacketsTransmitted()) / elapsed;
+    double bytesPerSecond = static_cast<double>(shaper->getBytesTransmitted()) / elapsed;
+    std::streamsize precision = std::cout.precision();
+    std::cout << "Byte budget used:   " << std::fixed << std::setprecision(1)
+              << 100.0 * bytesPerSecond / tokenRate << "% of " << (tokenRate / 1024)
+              << " KB/s\n";
+    if (packetLimit) {
+        std::cout << "Packet budget used: " << 100.0 * pps / packetRate << "% of "
+                  << packetRate << " pps\n";
+    } else {
+        std::cout << "Packet rate:        " << pps << " pps (no limit)\n";
+    }
+    std::cout << std::defaultfloat << std::setprecision(precision);
+
+    std::string csvPath = resultsPath(5, options, packetLimit ? "_pps" : "_bytes");
+    statsCollector->saveToCSV(csvPath);
+    std::cout << "Statistics saved to: " << csvPath << "\n";
+}
+
+void runScenario5(const SimulationOptions& options) {
+    std::cout << "\n========== Scenario 5: Small-Packet Flood ==========\n";
+    std::cout << "Testing a byte-rate limit against a packets-per-second limit\n";
+    std::cout << "Observing byte-bound versus packet-bound shaping\n";
+
+    runSmallPacketPhase(false, options);
+    runSmallPacketPhase(true, options);
+}
+
+void runSelectedScenario(int scenario, const SimulationOptions& options) {
+    switch (scenario) {
+        case 1:
+            runScenario1(options);
+            break;
+        case 2:
+            runScenario2(options);
+            break;
+        case 3:
+            runScenario3(options);
+            break;
+        case 4:
+            runScenario1(options);
+            std::cout << "\n\n";
+            runScenario2(options);
+            std::cout << "\n\n";
+            runScenario3(options);
+            std::cout << "\n\n";
+            runScenario5(options);
+            break;
+        case 5:
+            runScenario5(options);
+            break;
+    }
 }
 
 int main(int argc, char* argv[]) {
     printBanner();
     
     int scenario = 0;
-    
+    bool compare = false;
+    SimulationOptions options;
+    
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "ecn") {
+            options.ecn = true;
+        } else if (arg == "police") {
+            options.police = true;
+        } else if (arg == "peakrate") {
+            options.peakRate = true;
+        } else if (arg == "droplate") {
+            options.dropLate = true;
+        } else if (arg == "compare") {
+            compare = true;
+        } else if (arg.rfind("rank=", 0) == 0) {
+            options.pifoRank = arg.substr(5);
+            if (std::find(kPifoRanks.begin(), kPifoRanks.end(), options.pifoRank) ==
+                kPifoRanks.end()) {
+                std::cout << "Unknown rank '" << options.pifoRank
+                          << "'. Choose fifo, fq, edf, srpt or lstf.\n";
+                return 1;
+            }
+        } else if (arg.rfind("txqueues=", 0) == 0) {
+            options.txQueues = std::strtoul(arg.c_str() + 9, nullptr, 10);
+            if (options.txQueues < 1 || options.txQueues > kMaxTxQueues) {
+                std::cout << "TX queue count must be between 1 and " << kMaxTxQueues << ".\n";
+                return 1;
+            }
+        } else if (arg.rfind("batch=", 0) == 0) {
+            options.batchSize = std::strtoul(arg.c_str() + 6, nullptr, 10);
+            if (options.batchSize < 1 || options.batchSize > kMaxBatchSize) {
+                std::cout << "Batch size must be between 1 and " << kMaxBatchSize << ".\n";
+                return 1;
+            }
+        } else if (arg.rfind("schedule=", 0) == 0) {
+            auto schedule = std::make_shared<RateSchedule>();
+            options.scheduleFile = arg.substr(9);
+            if (!schedule->loadTrace(options.scheduleFile)) {
+                std::cout << "Cannot read rate schedule '" << options.scheduleFile << "'.\n";
+                return 1;
+            }
+            options.schedule = schedule;
+        } else if (isKnownMarker(arg)) {
+            options.marker = arg;
+        } else if (isKnownDiscipline(arg)) {
+            options.discipline = arg;
+        } else {
+            std::cout << "Unknown option '" << arg
+                      << "'. Choose priority, rr, drr, wf2q, edf, sfq, fq_codel, sharded, htb, hfsc, pace,"
+                      << " pifo (with rank=<fifo|fq|edf|srpt|lstf>) or compare"
+                      << " (all of them in turn), optionally with ecn"
+                      << ", an ingress marker (srtcm or trtcm), police, peakrate, droplate"
+                      << ", schedule=<file>, txqueues=<n> and batch=<n>.\n";
+            return 1;
+        }
+    }
+
     if (argc > 1) {
         scenario = std::atoi(argv[1]);
     } else {
@@ -245,30 +873,26 @@ int main(int argc, char* argv[]) {
         std::cout << "  2. Priority-Based QoS (different priorities)\n";
         std::cout << "  3. Bursty Traffic Handling (mixed traffic types)\n";
         std::cout << "  4. Run all scenarios\n";
-        std::cout << "\nEnter scenario number (1-4): ";
+        std::cout << "  5. Small-Packet Flood (packets/s vs bytes/s limits)\n";
+        std::cout << "\nEnter scenario number (1-5): ";
         std::cin >> scenario;
     }
     
-    switch (scenario) {
-        case 1:
-            runScenario1();
-            break;
-        case 2:
-            runScenario2();
-            break;
-        case 3:
-            runScenario3();
-            break;
-        case 4:
-            runScenario1();
-            std::cout << "\n\n";
-            runScenario2();
-            std::cout << "\n\n";
-            runScenario3();
-            break;
-        default:
-            std::cout << "Invalid scenario number. Please choose 1-4.\n";
-            return 1;
+    if (scenario < 1 || scenario > 5) {
+        std::cout << "Invalid scenario number. Please choose 1-5.\n";
+        return 1;
+    }
+
+    if (compare) {
+        // Same scenario and load under every discipline; each run writes
+        // its own results file
+        for (const std::string& discipline : kDisciplines) {
+            options.discipline = discipline;
+            std::cout << "\n########## Queue discipline: " << discipline << " ##########\n";
+            runSelectedScenario(scenario, options);
+        }
+    } else {
+        runSelectedScenario(scenario, options);
     }
     
     std::cout << "\n========== Simulation Complete ==========\n";